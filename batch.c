@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <err.h>
+
+#include "batch.h"
+#include "raster.h"
+#include "profile.h"
+
+/* all the rectangles of one color headed for one destination */
+typedef struct {
+   XftDraw     *draw;
+   XftColor    *color;
+   XRectangle  *rects;
+   int          nrects;
+   int          size;
+} bin_t;
+
+/*
+ * bins are kept across frames (only emptied on flush) so that a steady
+ * state frame allocates nothing.  they are found through a small open
+ * addressing hash on (draw, color).
+ */
+static bin_t  *bins = NULL;
+static int     nbins = 0;
+static int     bins_size = 0;
+static int    *table = NULL;        /* bin index + 1, 0 = empty */
+static int     table_size = 0;      /* power of 2 */
+
+
+static unsigned int
+bin_hash(XftDraw *d, XftColor *c)
+{
+   uintptr_t h = (uintptr_t)d * 31 + (uintptr_t)c;
+
+   h ^= h >> 7;
+   h *= 0x9e3779b1U;
+   return (unsigned int)(h ^ (h >> 15));
+}
+
+static void
+table_rebuild(int size)
+{
+   unsigned int slot;
+   int i;
+
+   free(table);
+   if ((table = calloc(size, sizeof(int))) == NULL)
+      err(1, "batch: table calloc failed");
+   table_size = size;
+
+   for (i = 0; i < nbins; i++) {
+      slot = bin_hash(bins[i].draw, bins[i].color) & (table_size - 1);
+      while (table[slot] != 0)
+         slot = (slot + 1) & (table_size - 1);
+      table[slot] = i + 1;
+   }
+}
+
+static bin_t *
+bin_find(XftDraw *d, XftColor *c)
+{
+   unsigned int slot;
+   bin_t *b;
+
+   if (table_size == 0)
+      table_rebuild(64);
+
+   slot = bin_hash(d, c) & (table_size - 1);
+   while (table[slot] != 0) {
+      b = &bins[table[slot] - 1];
+      if (b->draw == d && b->color == c)
+         return b;
+      slot = (slot + 1) & (table_size - 1);
+   }
+
+   /* new bin */
+   if (nbins == bins_size) {
+      bins_size = bins_size ? bins_size * 2 : 32;
+      if ((bins = realloc(bins, bins_size * sizeof(bin_t))) == NULL)
+         err(1, "batch: bins realloc failed");
+   }
+   b = &bins[nbins++];
+   b->draw   = d;
+   b->color  = c;
+   b->rects  = NULL;
+   b->nrects = b->size = 0;
+
+   if (2 * nbins > table_size)
+      table_rebuild(table_size * 2);
+   else
+      table[slot] = nbins;
+
+   return b;
+}
+
+void
+batch_rect(XftDraw *d, XftColor *c, int x, int y, int w, int h)
+{
+   XRectangle *r;
+   bin_t *b;
+
+   if (w <= 0 || h <= 0)
+      return;
+
+   /* the frame's own rectangles are rasterized client side, if asked to */
+   if (raster_enabled && d == XINFO.bar->xftdraw) {
+      raster_rect(x, y, w, h, c);
+      PROFILE_ADD(profile.rects, 1);
+      return;
+   }
+
+   b = bin_find(d, c);
+   if (b->nrects == b->size) {
+      b->size = b->size ? b->size * 2 : 64;
+      if ((b->rects = realloc(b->rects, b->size * sizeof(XRectangle))) == NULL)
+         err(1, "batch: rects realloc failed");
+   }
+
+   r = &b->rects[b->nrects++];
+   r->x = x;
+   r->y = y;
+   r->width = w;
+   r->height = h;
+   PROFILE_ADD(profile.rects, 1);
+}
+
+void
+batch_bar(XftDraw *d, int x, int width, int height, XftColor *bg,
+          int n, const int *h, XftColor **c)
+{
+   int top = 0;   /* height already covered by bars drawn later */
+
+   while (n-- > 0) {
+      if (h[n] > top) {
+         batch_rect(d, c[n], x, height - h[n], width, h[n] - top);
+         top = h[n];
+      }
+   }
+
+   batch_rect(d, bg, x, 0, width, height - top);
+}
+
+void
+batch_flush()
+{
+   bin_t *b;
+   int i;
+
+   for (i = 0; i < nbins; i++) {
+      b = &bins[i];
+      if (b->nrects == 0)
+         continue;
+
+      XRenderFillRectangles(XINFO.disp,
+         b->color->color.alpha == 0xffff ? PictOpSrc : PictOpOver,
+         XftDrawPicture(b->draw), &b->color->color, b->rects, b->nrects);
+      b->nrects = 0;
+      PROFILE_ADD(profile.fills, 1);
+   }
+}
+
+void
+batch_discard(XftDraw *d)
+{
+   int i;
+
+   for (i = 0; i < nbins; i++) {
+      if (bins[i].draw == d)
+         bins[i].nrects = 0;
+   }
+}
+
+void
+batch_close()
+{
+   int i;
+
+   for (i = 0; i < nbins; i++)
+      free(bins[i].rects);
+   free(bins);
+   free(table);
+
+   bins = NULL;
+   table = NULL;
+   nbins = bins_size = table_size = 0;
+}
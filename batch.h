@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "xstatbar.h"
+
+/*
+ * Rectangle batching.  Rather than issuing one XftDrawRect per bar
+ * segment, widgets push rectangles here and batch_flush() sends all the
+ * rectangles of one color (per destination) in a single
+ * XRenderFillRectangles request at the end of the frame.
+ *
+ * Since the flush order between colors is unspecified, everything pushed
+ * in a frame must be disjoint.  batch_bar() takes care of that for the
+ * usual stacked bar graphs.
+ *
+ * With -R, rectangles headed for the frame go to raster.h instead.
+ */
+
+void batch_rect(XftDraw *d, XftColor *c, int x, int y, int w, int h);
+
+/*
+ * a vertical bar at x, "width" pixels wide and "height" high: n bars of
+ * heights h[] (anchored at the bottom) and colors c[], painted as if each
+ * were drawn over the previous, over a background of color bg.
+ */
+void batch_bar(XftDraw *d, int x, int width, int height, XftColor *bg,
+               int n, const int *h, XftColor **c);
+
+void batch_flush();
+void batch_close();
+
+/* forget what was pushed for d since the last flush, unsent */
+void batch_discard(XftDraw *d);
+
+#endif
@@ -0,0 +1,904 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/*
+ * xstatbar-bench: times the drawing code against mock stats (see
+ * stats_mock.c), so changes to it can be measured without real hardware.
+ * It needs an X server, but a virtual one does fine:
+ *
+ *    Xvfb :9 & DISPLAY=:9 ./xstatbar-bench -n 64
+ *
+ * Every frame takes a new sample of everything and redraws the bar.  The
+ * results are printed as a single line of JSON.
+ *
+ * With -k, it times the tick kernels (see ticks.h) instead, without X:
+ * every kernel the cpu has, on random ticks of 1, 64 and 512 cpus (or
+ * -n).  Whether they are right is up to make check (see check.c).
+ * With -s, it times the span kernels (see span.h) the same way, on spans
+ * of 4 to 1920 pixels.
+ *
+ * With -p, it times the Linux collectors (stats_linux.c) on a fake /proc
+ * of 256 cpus (or -n), without X.  That needs them in place of the mock
+ * ones:  make linux-proc-bench && ./xstatbar-bench-linux -p
+ *
+ * With -m, it compares the layouts of the cpu history, without X: the
+ * pointer trees it used to be against the one block it is now, for the
+ * RSS each takes and the time to take a sample into it and to walk it as
+ * the graphs do, at 4, 64 and 256 cpus (or -n) of -l samples.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <err.h>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "xstatbar.h"
+#include "stats.h"
+#include "widget.h"
+#include "raster.h"
+#include "profile.h"
+#include "ticks.h"
+#include "span.h"
+#include "sampler.h"
+
+/* how many cpus the mock collectors (stats_mock.c) have */
+int mock_ncpu = 4;
+
+void
+usage(const char *pname)
+{
+   fprintf(stderr, "\
+usage: %s [-c | -H width] [-d widget[,widget...]] [-n ncpus] [-R]\n\
+          [-g width] [-G samples] [-l history] [-w width] [-h height]\n\
+          [-f font] [-N frames]\n\
+       %s -k [-n ncpus] [-N runs]\n\
+       %s -s [-N runs]\n\
+       %s -p [-n ncpus] [-N runs]\n\
+       %s -m [-n ncpus] [-l history] [-N runs]\n",
+   pname, pname, pname, pname, pname);
+   exit(1);
+}
+
+/* there is no sampler thread here: the history is resized in place */
+void
+sampler_resize(int hist_size)
+{
+   sysinfo_resize(hist_size);
+}
+
+/* microseconds on the monotonic clock */
+static long long
+now_us()
+{
+   struct timespec ts;
+
+   if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1)
+      err(1, "clock_gettime");
+
+   return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * bytes written by this process so far, from /proc/self/io where there
+ * is one.  the X connection is the only thing written to while timing,
+ * so the difference is what went over it.  -1 if unknown.
+ */
+static long long
+bytes_written()
+{
+   char  buf[1024], *p;
+   ssize_t n;
+   int   fd;
+
+   if ((fd = open("/proc/self/io", O_RDONLY)) == -1)
+      return -1;
+   n = read(fd, buf, sizeof(buf) - 1);
+   close(fd);
+   if (n <= 0)
+      return -1;
+   buf[n] = '\0';
+
+   if ((p = strstr(buf, "wchar:")) == NULL)
+      return -1;
+   return strtoll(p + 6, NULL, 10);
+}
+
+static int
+cmp_ll(const void *a, const void *b)
+{
+   long long x = *(const long long *)a, y = *(const long long *)b;
+
+   return (x > y) - (x < y);
+}
+
+/* nearest-rank percentile of the sorted t[n] */
+static long long
+percentile(const long long *t, int n, int pct)
+{
+   int rank = (pct * n + 99) / 100;
+
+   return t[rank > 0 ? rank - 1 : 0];
+}
+
+/* pseudo random numbers, the same every run */
+static uint64_t
+ticks_rand()
+{
+   static uint64_t x = 88172645463325252ULL;
+
+   x ^= x << 13;
+   x ^= x >> 7;
+   x ^= x << 17;
+   return x;
+}
+
+/* time the kernels on ncpu cpus; prints their JSON */
+static void
+ticks_bench(int ncpu, int runs, bool first)
+{
+   uint64_t *samples[16];
+   long long start, ns;
+   int avg[CPUSTATES];
+   int i, k, run;
+
+   /* 16 samples of ticks, each one to a few hundred on from the last */
+   for (i = 0; i < 16; i++) {
+      if ((samples[i] = calloc(ncpu * CPUSTATES, sizeof(uint64_t))) == NULL)
+         err(1, "calloc");
+   }
+   for (i = 0; i < ncpu * CPUSTATES; i++) {
+      samples[0][i] = ticks_rand() % 1000000;
+      for (k = 1; k < 16; k++)
+         samples[k][i] = samples[k - 1][i] + ticks_rand() % 300;
+   }
+
+   for (k = 0; k < TICKS_KERNELS; k++) {
+      if (!ticks_use(k))
+         continue;
+
+      start = profile_ns();
+      for (run = 0; run < runs; run++)
+         ticks_percent(samples[(run + 1) % 16], samples[run % 16], ncpu, avg);
+      ns = profile_ns() - start;
+
+      printf("%s{\"kernel\":\"%s\",\"ncpu\":%d,\"runs\":%d,"
+             "\"ns\":%.1f,\"ns_per_cpu\":%.2f}",
+         first ? "" : ",", ticks_kernel_name(k), ncpu, runs,
+         (double)ns / runs, (double)ns / runs / ncpu);
+      first = false;
+   }
+
+   for (i = 0; i < 16; i++)
+      free(samples[i]);
+}
+
+/* -k */
+static int
+ticks_main(int ncpu, int runs)
+{
+   static const int ncpus[] = { 1, 64, 512 };
+   int best, i;
+
+   best = ticks_kernel();
+
+   printf("{\"best\":\"%s\",\"ticks\":[", ticks_kernel_name(best));
+   if (ncpu > 0)
+      ticks_bench(ncpu, runs, true);
+   else {
+      for (i = 0; i < 3; i++)
+         ticks_bench(ncpus[i], runs, i == 0);
+   }
+   printf("]}\n");
+   return 0;
+}
+
+/*
+ * -p: a fake /proc, in a directory of its own.  every sample is a new
+ * stat, each cpu a few ticks on from the last; the rest stays the same.
+ */
+static const char proc_meminfo[] =
+   "MemTotal:       32768000 kB\n"
+   "MemFree:         9000000 kB\n"
+   "MemAvailable:   20000000 kB\n"
+   "Buffers:          500000 kB\n"
+   "Cached:         10000000 kB\n"
+   "SwapCached:            0 kB\n"
+   "Active:         12000000 kB\n"
+   "Inactive:        8000000 kB\n"
+   "Active(anon):    6000000 kB\n"
+   "Inactive(anon):   200000 kB\n"
+   "Active(file):    6000000 kB\n"
+   "Inactive(file):  7800000 kB\n"
+   "Unevictable:           0 kB\n"
+   "Mlocked:               0 kB\n"
+   "SwapTotal:      16777212 kB\n"
+   "SwapFree:       16000000 kB\n"
+   "Dirty:               100 kB\n"
+   "Writeback:             0 kB\n"
+   "AnonPages:       6200000 kB\n"
+   "Mapped:          1000000 kB\n"
+   "Shmem:            300000 kB\n";
+static const char proc_swaps[] =
+   "Filename\t\t\t\tType\t\tSize\t\tUsed\t\tPriority\n"
+   "/dev/nvme0n1p3                          partition\t8388604\t\t500000\t\t-2\n"
+   "/swapfile                               file\t\t8388608\t\t277212\t\t-3\n";
+static const char proc_loadavg[] = "0.52 0.58 0.59 3/1234 56789\n";
+
+static char  proc_dir[] = "/tmp/xstatbar-bench.XXXXXX";
+static char *proc_buf = NULL;
+static int   proc_stat_fd = -1;
+
+static void
+proc_file(const char *name, const char *text, size_t len, int *keep)
+{
+   char path[PATH_MAX];
+   int  fd;
+
+   snprintf(path, sizeof(path), "%s/%s", proc_dir, name);
+   if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600)) == -1)
+      err(1, "%s", path);
+   if (write(fd, text, len) != (ssize_t)len)
+      err(1, "%s: write", path);
+   if (keep != NULL)
+      *keep = fd;
+   else
+      close(fd);
+}
+
+/* /proc/stat as of sample n, written over the last */
+static void
+proc_stat(int ncpu, int n)
+{
+   uint64_t user, sys, idle;
+   char *p;
+   int   cpu, i;
+
+   p = proc_buf;
+   p += sprintf(p, "cpu  %llu 0 %llu %llu 0 0 0 0 0 0\n",
+      (unsigned long long)ncpu * (100000 + n * 40),
+      (unsigned long long)ncpu * (20000 + n * 10),
+      (unsigned long long)ncpu * (900000 + n * 50));
+   for (cpu = 0; cpu < ncpu; cpu++) {
+      user = 100000 + n * (cpu % 7) * 10 + cpu;
+      sys  = 20000 + n * (cpu % 3) * 5;
+      idle = 900000 + n * (100 - (cpu % 7) * 10 - (cpu % 3) * 5);
+      p += sprintf(p, "cpu%d %llu %d %llu %llu %d %d %d 0 0 0\n", cpu,
+         (unsigned long long)user, cpu % 5, (unsigned long long)sys,
+         (unsigned long long)idle, n % 4, cpu % 11, n % 6);
+   }
+
+   /* a real one goes on with as many interrupt counts as there are irqs */
+   p += sprintf(p, "intr %d", 1000000 + n);
+   for (i = 0; i < 512; i++)
+      p += sprintf(p, " %d", i % 3 ? 0 : i * 17);
+   p += sprintf(p, "\nctxt %d\nbtime 1700000000\nprocesses 56789\n"
+      "procs_running 3\nprocs_blocked 0\n", 1000000 + n * 31);
+
+   if (pwrite(proc_stat_fd, proc_buf, p - proc_buf, 0) != p - proc_buf
+   ||  ftruncate(proc_stat_fd, p - proc_buf) == -1)
+      err(1, "%s/stat", proc_dir);
+}
+
+static const char *proc_names[] = { "stat", "meminfo", "swaps", "loadavg" };
+
+static void
+proc_remove()
+{
+   char path[PATH_MAX];
+   int  i;
+
+   close(proc_stat_fd);
+   for (i = 0; i < 4; i++) {
+      snprintf(path, sizeof(path), "%s/%s", proc_dir, proc_names[i]);
+      unlink(path);
+   }
+   rmdir(proc_dir);
+   free(proc_buf);
+}
+
+/* -s: every kernel on spans of a few lengths, from every alignment */
+static int
+span_main(int runs)
+{
+   static const int lengths[] = { 4, 13, 45, 300, 1920 };
+   uint32_t buf[1920 + 8];
+   long long start, ns;
+   bool first;
+   int best, i, k, run;
+
+   best = span_kernel();
+   first = true;
+
+   printf("{\"best\":\"%s\",\"spans\":[", ticks_kernel_name(best));
+   for (i = 0; i < 5; i++) {
+      for (k = 0; k < TICKS_KERNELS; k++) {
+         if (!span_use(k))
+            continue;
+
+         start = profile_ns();
+         for (run = 0; run < runs; run++)
+            span_fill(buf + run % 8, lengths[i], run);
+         ns = profile_ns() - start;
+
+         printf("%s{\"kernel\":\"%s\",\"pixels\":%d,\"runs\":%d,"
+                "\"ns\":%.2f,\"ns_per_pixel\":%.3f}",
+            first ? "" : ",", ticks_kernel_name(k), lengths[i], runs,
+            (double)ns / runs, (double)ns / runs / lengths[i]);
+         first = false;
+      }
+   }
+   printf("]}\n");
+
+   span_use(best);
+   return 0;
+}
+
+/* -p */
+static int
+proc_main(int ncpu, int runs, int hist)
+{
+   long long cpu_ns, mem_ns, swap_ns, procs_ns, t;
+   unsigned long syscalls;
+   int  i;
+
+   if (ncpu == 0)
+      ncpu = 256;
+   if (mkdtemp(proc_dir) == NULL)
+      err(1, "mkdtemp");
+   if ((proc_buf = malloc(ncpu * 128 + 16384)) == NULL)
+      err(1, "malloc");
+
+   proc_file(proc_names[0], "", 0, &proc_stat_fd);
+   proc_stat(ncpu, 0);
+   proc_file(proc_names[1], proc_meminfo, sizeof(proc_meminfo) - 1, NULL);
+   proc_file(proc_names[2], proc_swaps, sizeof(proc_swaps) - 1, NULL);
+   proc_file(proc_names[3], proc_loadavg, sizeof(proc_loadavg) - 1, NULL);
+
+   setenv("XSTATBAR_PROCFS", proc_dir, 1);
+   sysinfo_init(hist);
+   if (sysinfo.ncpu != ncpu || sysinfo.procs_total != 1234) {
+      proc_remove();
+      errx(1, "-p times the /proc collectors, so needs them: "
+         "make linux-proc-bench");
+   }
+
+   cpu_ns = mem_ns = swap_ns = procs_ns = 0;
+   syscalls = stat_syscalls;
+   for (i = 1; i <= runs; i++) {
+      proc_stat(ncpu, i);
+
+      t = profile_ns();
+      cpu_update();
+      cpu_ns += profile_ns() - t;
+
+      t = profile_ns();
+      mem_update();
+      mem_ns += profile_ns() - t;
+
+      t = profile_ns();
+      swap_update();
+      swap_ns += profile_ns() - t;
+
+      t = profile_ns();
+      procs_update();
+      procs_ns += profile_ns() - t;
+   }
+   syscalls = stat_syscalls - syscalls;
+
+   printf("{\"ncpu\":%d,\"runs\":%d,\"us_per_sample\":{\"cpu\":%.2f,"
+          "\"mem\":%.2f,\"swap\":%.2f,\"procs\":%.2f},"
+          "\"syscalls_per_sample\":%.1f}\n",
+      ncpu, runs, cpu_ns / 1000.0 / runs, mem_ns / 1000.0 / runs,
+      swap_ns / 1000.0 / runs, procs_ns / 1000.0 / runs,
+      (double)syscalls / runs);
+
+   sysinfo_close();
+   proc_remove();
+   return 0;
+}
+
+/*
+ * -m: the cpu history as it was, [ncpu][hist][CPUSTATES] trees of a
+ * calloc per cpu and sample, of the raw ticks and of the percentages; and
+ * as it is, the ticks of the last two samples and a run of hist ints per
+ * cpu and state in one cache-line aligned block (see sysinfo_hist_alloc(),
+ * here without the tiers).  a sample turns ticks into percentages the
+ * same simple way for both, so only the layout differs.
+ */
+typedef struct {
+   bool        trees;      /* which of them */
+   int         ncpu, hist, cur;
+   uint64_t ***raw;        /* the trees */
+   int      ***pcnts;
+   void       *block;      /* the block */
+   uint64_t   *raw2;       /* [2][ncpu][CPUSTATES] */
+   int        *series;     /* [ncpu][CPUSTATES][hist] */
+} layout_bench_t;
+
+static void
+trees_init(layout_bench_t *b)
+{
+   int cpu, i;
+
+   if ((b->raw = calloc(b->ncpu, sizeof(uint64_t **))) == NULL
+   ||  (b->pcnts = calloc(b->ncpu, sizeof(int **))) == NULL)
+      err(1, "calloc");
+   for (cpu = 0; cpu < b->ncpu; cpu++) {
+      if ((b->raw[cpu] = calloc(b->hist, sizeof(uint64_t *))) == NULL
+      ||  (b->pcnts[cpu] = calloc(b->hist, sizeof(int *))) == NULL)
+         err(1, "calloc");
+      for (i = 0; i < b->hist; i++) {
+         if ((b->raw[cpu][i] = calloc(CPUSTATES, sizeof(uint64_t))) == NULL
+         ||  (b->pcnts[cpu][i] = calloc(CPUSTATES, sizeof(int))) == NULL)
+            err(1, "calloc");
+      }
+   }
+}
+
+static void
+trees_sample(layout_bench_t *b, int n)
+{
+   uint64_t *cur, *prev, d[CPUSTATES], total;
+   int cpu, state;
+
+   for (cpu = 0; cpu < b->ncpu; cpu++) {
+      prev = b->raw[cpu][b->cur];
+      cur  = b->raw[cpu][(b->cur + 1) % b->hist];
+      total = 0;
+      for (state = 0; state < CPUSTATES; state++) {
+         cur[state] = prev[state] + (n * 7 + cpu * 3 + state * 11) % 97;
+         total += d[state] = cur[state] - prev[state];
+      }
+      for (state = 0; state < CPUSTATES; state++)
+         b->pcnts[cpu][(b->cur + 1) % b->hist][state] =
+            total ? d[state] * 100 / total : 0;
+   }
+   b->cur = (b->cur + 1) % b->hist;
+}
+
+/* every state of every cpu, oldest sample first, as a graph goes */
+static long long
+trees_walk(layout_bench_t *b)
+{
+   long long sum;
+   int cpu, state, i;
+
+   sum = 0;
+   for (cpu = 0; cpu < b->ncpu; cpu++) {
+      for (state = 0; state < CPUSTATES; state++) {
+         for (i = 1; i <= b->hist; i++)
+            sum += b->pcnts[cpu][(b->cur + i) % b->hist][state];
+      }
+   }
+   return sum;
+}
+
+static void
+block_init(layout_bench_t *b)
+{
+   size_t raw_bytes, bytes;
+
+   raw_bytes = 2 * b->ncpu * CPUSTATES * sizeof(uint64_t);
+   bytes = raw_bytes + b->ncpu * CPUSTATES * b->hist * sizeof(int);
+   if (posix_memalign(&b->block, 64, bytes))
+      err(1, "posix_memalign");
+   memset(b->block, 0, bytes);
+   b->raw2 = b->block;
+   b->series = (int *)((char *)b->block + raw_bytes);
+}
+
+static void
+block_sample(layout_bench_t *b, int n)
+{
+   uint64_t *cur, *prev, d[CPUSTATES], total;
+   int cpu, state, next;
+
+   next = (b->cur + 1) % b->hist;
+   for (cpu = 0; cpu < b->ncpu; cpu++) {
+      prev = b->raw2 + ((n % 2) * b->ncpu + cpu) * CPUSTATES;
+      cur  = b->raw2 + ((!(n % 2)) * b->ncpu + cpu) * CPUSTATES;
+      total = 0;
+      for (state = 0; state < CPUSTATES; state++) {
+         cur[state] = prev[state] + (n * 7 + cpu * 3 + state * 11) % 97;
+         total += d[state] = cur[state] - prev[state];
+      }
+      for (state = 0; state < CPUSTATES; state++)
+         b->series[(cpu * CPUSTATES + state) * b->hist + next] =
+            total ? d[state] * 100 / total : 0;
+   }
+   b->cur = next;
+}
+
+static long long
+block_walk(layout_bench_t *b)
+{
+   long long sum;
+   int *s, cpu, state, i;
+
+   sum = 0;
+   for (cpu = 0; cpu < b->ncpu; cpu++) {
+      for (state = 0; state < CPUSTATES; state++) {
+         s = b->series + (cpu * CPUSTATES + state) * b->hist;
+         for (i = 1; i <= b->hist; i++)
+            sum += s[(b->cur + i) % b->hist];
+      }
+   }
+   return sum;
+}
+
+static void
+lb_init(layout_bench_t *b, bool trees, int ncpu, int hist)
+{
+   memset(b, 0, sizeof(*b));
+   b->trees = trees;
+   b->ncpu  = ncpu;
+   b->hist  = hist;
+   if (trees)
+      trees_init(b);
+   else
+      block_init(b);
+}
+
+static void
+lb_sample(layout_bench_t *b, int n)
+{
+   if (b->trees)
+      trees_sample(b, n);
+   else
+      block_sample(b, n);
+}
+
+static long long
+lb_walk(layout_bench_t *b)
+{
+   return b->trees ? trees_walk(b) : block_walk(b);
+}
+
+/* the RSS now, in kilobytes: from /proc/self/statm where there is one */
+static long
+rss_kb()
+{
+   struct rusage ru;
+   char  buf[128];
+   long  pages, rss;
+   FILE *f;
+
+   if ((f = fopen("/proc/self/statm", "r")) != NULL) {
+      rss = -1;
+      if (fgets(buf, sizeof(buf), f) != NULL
+      &&  sscanf(buf, "%ld %ld", &pages, &rss) == 2)
+         rss *= sysconf(_SC_PAGESIZE) / 1024;
+      fclose(f);
+      if (rss >= 0)
+         return rss;
+   }
+
+   /* the most it ever was, which will do in a fresh child */
+   if (getrusage(RUSAGE_SELF, &ru) == -1)
+      err(1, "getrusage");
+   return ru.ru_maxrss;
+}
+
+/*
+ * one layout at ncpu cpus, in a child so the RSS it adds is its own;
+ * prints its JSON
+ */
+static void
+layout_bench(bool trees, int ncpu, int hist, int runs, bool first)
+{
+   layout_bench_t b;
+   long long start, sample_ns, walk_ns, sum;
+   long rss0, rss1;
+   pid_t pid;
+   int i, status;
+
+   fflush(stdout);
+   if ((pid = fork()) == -1)
+      err(1, "fork");
+   if (pid != 0) {
+      if (waitpid(pid, &status, 0) == -1)
+         err(1, "waitpid");
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+         errx(1, "-m: the %s child failed", trees ? "trees" : "block");
+      return;
+   }
+
+   /*
+    * a child faults in the code it runs as it goes, so all of it is run
+    * on a tiny layout first, before the RSS it starts from is taken
+    */
+   lb_init(&b, trees, 1, 2);
+   lb_sample(&b, 0);
+   lb_walk(&b);
+   rss_kb();
+   profile_ns();
+
+   rss0 = rss_kb();
+   lb_init(&b, trees, ncpu, hist);
+   for (i = 0; i < hist; i++)
+      lb_sample(&b, i);
+   rss1 = rss_kb();
+
+   /* then time a sample, and a walk of all of it */
+   sample_ns = walk_ns = sum = 0;
+   for (i = 0; i < runs; i++) {
+      start = profile_ns();
+      lb_sample(&b, hist + i);
+      sample_ns += profile_ns() - start;
+
+      start = profile_ns();
+      sum += lb_walk(&b);
+      walk_ns += profile_ns() - start;
+   }
+
+   printf("%s{\"layout\":\"%s\",\"ncpu\":%d,\"hist_size\":%d,"
+          "\"rss_kb\":%ld,\"sample_us\":%.2f,\"walk_us\":%.2f,"
+          "\"sum\":%lld}",
+      first ? "" : ",", trees ? "trees" : "block", ncpu, hist, rss1 - rss0,
+      sample_ns / 1000.0 / runs, walk_ns / 1000.0 / runs, sum);
+   fflush(stdout);
+   _exit(0);
+}
+
+/* -m */
+static int
+layout_main(int ncpu, int hist, int runs)
+{
+   static const int ncpus[] = { 4, 64, 256 };
+   int i;
+
+   printf("{\"layouts\":[");
+   for (i = 0; i < 3; i++) {
+      if (ncpu > 0 && i > 0)
+         break;
+      layout_bench(true, ncpu > 0 ? ncpu : ncpus[i], hist, runs, i == 0);
+      layout_bench(false, ncpu > 0 ? ncpu : ncpus[i], hist, runs, false);
+   }
+   printf("]}\n");
+   return 0;
+}
+
+/* one new sample of everything (but the time, which is made up here) */
+static void
+sample(int frame)
+{
+   int i;
+
+   for (i = 0; i < nwidgets; i++) {
+      if (widgets[i].enabled && widgets[i].update != NULL
+      &&  widgets[i].update != time_update)
+         widget_update(&widgets[i]);
+   }
+   snprintf(timeinfo.str, sizeof(timeinfo.str), "frame %d", frame);
+}
+
+/* forget what the widgets cost so far */
+static void
+reset_costs()
+{
+   int i;
+
+   for (i = 0; i < nwidgets; i++) {
+      widgets[i].updates = widgets[i].draws = 0;
+      widgets[i].update_ns = widgets[i].draw_ns = 0;
+   }
+}
+
+int
+main(int argc, char *argv[])
+{
+   const char *errstr;
+   struct rusage ru;
+   long long *times, t, bytes0, bytes1, total;
+   unsigned long requests;
+   char *font;
+   bool  kernels, spans, procfs, layouts;
+   int   ch, w, h, hist, frames, ncpu, i;
+
+   /* defaults: what xstatbar uses, on a 1920 pixel wide screen */
+   w = 1920;
+   h = 13;
+   hist = 0;
+   frames = 1000;
+   font = "Fixed-6";
+   kernels = spans = procfs = layouts = false;
+   ncpu = 0;
+
+   while ((ch = getopt(argc, argv, "cH:d:n:Rg:G:l:w:h:f:N:kspm")) != -1) {
+      switch (ch) {
+         case 'c':
+            cpu_mode = CPUS_ALL;
+            break;
+
+         case 'H':
+            cpu_mode = CPUS_HEATMAP;
+            heatmap_width = strtonum(optarg, 1, INT_MAX, &errstr);
+            if (errstr)
+               errx(1, "illegal heatmap width \"%s\": %s", optarg, errstr);
+            break;
+
+         case 'd':
+            widget_disable(optarg);
+            break;
+
+         case 'n':
+            mock_ncpu = ncpu = strtonum(optarg, 1, 4096, &errstr);
+            if (errstr)
+               errx(1, "illegal number of cpus \"%s\": %s", optarg, errstr);
+            break;
+
+         case 'R':
+            raster_enabled = true;
+            break;
+
+         case 'g':
+            graph_width = strtonum(optarg, 1, 100000, &errstr);
+            if (errstr)
+               errx(1, "illegal graph width \"%s\": %s", optarg, errstr);
+            break;
+
+         case 'G':
+            cpu_window = mem_window = strtonum(optarg, 1, 10000000, &errstr);
+            if (errstr)
+               errx(1, "illegal graph window \"%s\": %s", optarg, errstr);
+            break;
+
+         case 'l':
+            hist = strtonum(optarg, 2, 100000, &errstr);
+            if (errstr)
+               errx(1, "illegal history size \"%s\": %s", optarg, errstr);
+            break;
+
+         case 'w':
+            w = strtonum(optarg, 1, 100000, &errstr);
+            if (errstr)
+               errx(1, "illegal width \"%s\": %s", optarg, errstr);
+            break;
+
+         case 'h':
+            h = strtonum(optarg, 1, 10000, &errstr);
+            if (errstr)
+               errx(1, "illegal height \"%s\": %s", optarg, errstr);
+            break;
+
+         case 'f':
+            font = optarg;
+            break;
+
+         case 'N':
+            frames = strtonum(optarg, 1, 10000000, &errstr);
+            if (errstr)
+               errx(1, "illegal number of frames \"%s\": %s", optarg, errstr);
+            break;
+
+         case 'k':
+            kernels = true;
+            break;
+
+         case 's':
+            spans = true;
+            break;
+
+         case 'p':
+            procfs = true;
+            break;
+
+         case 'm':
+            layouts = true;
+            break;
+
+         default:
+            usage(argv[0]);
+            /* UNREACHABLE */
+      }
+   }
+
+   if (kernels)
+      return ticks_main(ncpu, frames);
+   if (spans)
+      return span_main(frames);
+   if (procfs)
+      return proc_main(ncpu, frames, hist == 0 ? graph_width : hist);
+   if (layouts)
+      return layout_main(ncpu, hist == 0 ? graph_width : hist, frames);
+
+   if ((times = calloc(frames, sizeof(long long))) == NULL)
+      err(1, "calloc");
+
+   /* as xstatbar sizes it, unless told otherwise */
+   if (hist == 0)
+      hist = hist_size_for(MAX(graph_width, heatmap_width), cpu_window);
+
+   for (i = 0; i < nwidgets; i++) {
+      if (widgets[i].enabled && widgets[i].init != NULL)
+         widgets[i].init();
+   }
+   sysinfo_init(hist);
+   setup_x(0, 0, w, h, font);
+
+   /* warm up: fill the graphs, get the window mapped and drawn once */
+   for (i = 0; i < MAX(hist, cpu_window); i++)
+      sample(-1);
+   XSync(XINFO.disp, False);
+   process_events();
+   draw();
+   XSync(XINFO.disp, False);
+   reset_costs();
+
+   requests = 0;
+   total = 0;
+   bytes0 = bytes_written();
+   for (i = 0; i < frames; i++) {
+      sample(i);
+
+      t = now_us();
+      draw();
+      XSync(XINFO.disp, False);
+      times[i] = now_us() - t;
+
+      total += times[i];
+      requests += XINFO.frame_requests;
+   }
+   bytes1 = bytes_written();
+
+   if (getrusage(RUSAGE_SELF, &ru) == -1)
+      err(1, "getrusage");
+
+   qsort(times, frames, sizeof(long long), cmp_ll);
+   printf("{\"ncpu\":%d,\"hist_size\":%d,\"graph_width\":%d,"
+          "\"window\":%d,\"width\":%d,\"height\":%d,"
+          "\"cpu_mode\":%d,\"raster\":%s,\"frames\":%d,"
+          "\"frame_us\":{\"mean\":%lld,\"p50\":%lld,\"p90\":%lld,"
+          "\"p99\":%lld,\"max\":%lld},"
+          "\"requests_per_frame\":%.2f,",
+      sysinfo.ncpu, hist, graph_width, cpu_window, w, h, cpu_mode,
+      raster_enabled ? "true" : "false", frames,
+      total / frames, percentile(times, frames, 50),
+      percentile(times, frames, 90), percentile(times, frames, 99),
+      times[frames - 1], (double)requests / frames);
+   if (bytes0 == -1 || bytes1 == -1)
+      printf("\"bytes_per_frame\":null,");
+   else
+      printf("\"bytes_per_frame\":%.1f,", (double)(bytes1 - bytes0) / frames);
+   printf("\"maxrss_kb\":%ld,", (long)ru.ru_maxrss);
+
+   /* and what each widget cost, per frame */
+   printf("\"widgets\":{");
+   for (i = 0; i < nwidgets; i++) {
+      printf("%s\"%s\":{\"enabled\":%s,\"update_us\":%.2f,\"draw_us\":%.2f}",
+         i == 0 ? "" : ",", widgets[i].name,
+         widgets[i].enabled ? "true" : "false",
+         widgets[i].update_ns / 1000.0 / frames,
+         widgets[i].draw_ns / 1000.0 / frames);
+   }
+   printf("}}\n");
+
+   close_x();
+   for (i = 0; i < nwidgets; i++) {
+      if (widgets[i].enabled && widgets[i].close != NULL)
+         widgets[i].close();
+   }
+   sysinfo_close();
+   free(times);
+   return 0;
+}
@@ -0,0 +1,827 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/*
+ * xstatbar-check (make check): checks what can be checked without X, and
+ * exits non-zero, saying what, at the first thing that is wrong.
+ *
+ *    the tick kernels (see ticks.h): each the cpu has, against cases
+ *    with known results, and against the plain C one on random ticks
+ *
+ *    the span kernels (see span.h): each the cpu has, filling every
+ *    length up to 100 pixels from every alignment, and nothing around
+ *
+ *    laying out the bar (layout_fit()): a slot drawn narrower or wider,
+ *    but within its min, doesn't move anything; past that, or over its
+ *    max, it does.
+ *
+ *    the average of the cpus (cpu -1, see cpu_sample_end()): against one
+ *    worked out here from every cpu's percentages, with some of the cpus
+ *    offline.  on Linux that is on a fake /proc of CHECK_NCPU cpus, so
+ *    there are a few however many this machine has.
+ *
+ *    swap (swap_update()): the used and total of a few devices.  on
+ *    OpenBSD swapctl(2) is stubbed out for a table of fake devices, and
+ *    the samples after the first may not allocate anything.
+ *
+ *    resizing the history (sysinfo_resize()), bigger then smaller: every
+ *    tier of the cpus' and memory's keeps what fits, the newest of it,
+ *    and sampling carries on from there.  once in memory, and once in a
+ *    history file, whose header has to follow.
+ *
+ *    the sampler, with a mixer on a pipe for its one widget: whatever is
+ *    written to that is published as the volume, a write that changes
+ *    nothing isn't published, and once the pipe is closed the widget
+ *    drops its fd and isn't updated again.
+ */
+
+#include <sys/param.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <err.h>
+
+#ifdef __OpenBSD__
+#include <sys/swap.h>
+#endif
+
+#include "stats.h"
+#include "history.h"
+#include "ticks.h"
+#include "span.h"
+#include "widget.h"
+#include "layout.h"
+#include "sampler.h"
+#include "profile.h"
+
+/* pseudo random numbers, the same every run */
+static uint64_t
+check_rand()
+{
+   static uint64_t x = 88172645463325252ULL;
+
+   x ^= x << 13;
+   x ^= x >> 7;
+   x ^= x << 17;
+   return x;
+}
+
+
+/*****************************************************************************
+ * the tick kernels
+ ****************************************************************************/
+
+/* a case: one cpu's counters, and what they come to */
+static const struct {
+   const char *what;
+   uint64_t    prev[2], cur[2];   /* of the first and last state */
+   int         pct[2];
+} ticks_cases[] = {
+   { "32 bit wrap",  { 0xfffffffbULL, 6 },  { 5, 16 },            { 50, 50 } },
+   { "64 bit wrap",  { UINT64_MAX - 2, 0 }, { 3, 6 },             { 50, 50 } },
+   { "32 bit back",  { 100, 0 },            { 90, 10 },           { 0, 100 } },
+   { "64 bit back",  { 1ULL << 40, 0 },     { (1ULL << 40) - 5, 10 },
+                                                                  { 0, 100 } },
+   { "offline",      { 1234, 5678 },        { 1234, 5678 },       { 0, 0 } },
+   { "thirds",       { 0, 0 },              { 1, 2 },             { 33, 67 } },
+   { "half up",      { 0, 0 },              { 1, 199 },           { 1, 100 } },
+   { "scaled down",  { 0, 0 },              { 1000000, 3000000 }, { 25, 75 } },
+};
+
+static void
+ticks_check(int k)
+{
+   uint64_t prev[67 * CPUSTATES], cur[67 * CPUSTATES];
+   int want[67 * CPUSTATES], avg[CPUSTATES], want_avg[CPUSTATES];
+   const int *pct;
+   int i, n, ncpu, trial;
+
+   for (i = 0; i < (int)(sizeof(ticks_cases) / sizeof(ticks_cases[0])); i++) {
+      memset(prev, 0, sizeof(prev));
+      memset(cur, 0, sizeof(cur));
+      prev[0] = ticks_cases[i].prev[0];
+      cur[0]  = ticks_cases[i].cur[0];
+      prev[CPUSTATES - 1] = ticks_cases[i].prev[1];
+      cur[CPUSTATES - 1]  = ticks_cases[i].cur[1];
+
+      ticks_use(k);
+      pct = ticks_percent(cur, prev, 1, avg);
+      if (pct[0] != ticks_cases[i].pct[0]
+      ||  pct[CPUSTATES - 1] != ticks_cases[i].pct[1])
+         errx(1, "%s kernel: %s: %d%% and %d%%, not %d%% and %d%%",
+            ticks_kernel_name(k), ticks_cases[i].what, pct[0],
+            pct[CPUSTATES - 1], ticks_cases[i].pct[0], ticks_cases[i].pct[1]);
+   }
+
+   /*
+    * every count of cpus up to 67 goes through the kernels' tails; some
+    * counters go back a little, some are near the top of 32 bits
+    */
+   for (ncpu = 1; ncpu <= 67; ncpu++) {
+      for (trial = 0; trial < 100; trial++) {
+         n = ncpu * CPUSTATES;
+         for (i = 0; i < n; i++) {
+            prev[i] = trial % 2 ? check_rand() : check_rand() % UINT32_MAX;
+            cur[i] = prev[i] + check_rand() % (trial % 3 ? 1000 : 100000);
+            if (check_rand() % 8 == 0)
+               cur[i] = prev[i] - check_rand() % 100;
+         }
+
+         ticks_use(TICKS_SCALAR);
+         memcpy(want, ticks_percent(cur, prev, ncpu, want_avg),
+            n * sizeof(int));
+         ticks_use(k);
+         pct = ticks_percent(cur, prev, ncpu, avg);
+         if (memcmp(pct, want, n * sizeof(int)) != 0
+         ||  memcmp(avg, want_avg, sizeof(avg)) != 0)
+            errx(1, "%s kernel: differs from the scalar one at %d cpus",
+               ticks_kernel_name(k), ncpu);
+      }
+   }
+}
+
+static void
+check_ticks()
+{
+   int best, k;
+
+   best = ticks_kernel();
+   printf("ticks:");
+   for (k = 0; k < TICKS_KERNELS; k++) {
+      if (ticks_use(k)) {
+         ticks_check(k);
+         printf(" %s", ticks_kernel_name(k));
+      }
+   }
+   ticks_use(best);
+   printf(" ok\n");
+}
+
+
+/*****************************************************************************
+ * the span kernels
+ ****************************************************************************/
+
+static void
+span_check(int k)
+{
+   uint32_t buf[8 + 100 + 8];
+   int off, n, i;
+
+   span_use(k);
+   for (off = 0; off < 8; off++) {
+      for (n = 0; n <= 100; n++) {
+         for (i = 0; i < (int)(sizeof(buf) / sizeof(buf[0])); i++)
+            buf[i] = i;
+         span_fill(buf + off, n, 0xdeadbeef);
+         for (i = 0; i < (int)(sizeof(buf) / sizeof(buf[0])); i++) {
+            if (buf[i] != (i >= off && i < off + n ? 0xdeadbeef : (uint32_t)i))
+               errx(1, "%s span: %d pixels from %d: pixel %d is %#x",
+                  ticks_kernel_name(k), n, off, i, buf[i]);
+         }
+      }
+   }
+}
+
+static void
+check_spans()
+{
+   int best, k;
+
+   best = span_kernel();
+   printf("spans:");
+   for (k = 0; k < TICKS_KERNELS; k++) {
+      if (span_use(k)) {
+         span_check(k);
+         printf(" %s", ticks_kernel_name(k));
+      }
+   }
+   span_use(best);
+   printf(" ok\n");
+}
+
+
+/*****************************************************************************
+ * the system's stats
+ ****************************************************************************/
+
+#ifdef __linux__
+#define CHECK_NCPU 6
+
+static const char *fake_names[] = { "stat", "meminfo", "swaps", "loadavg" };
+static char        fake_dir[] = "/tmp/xstatbar-check.XXXXXX";
+
+/* two devices, 777212 kB of 16777212 kB used */
+static const char fake_swaps[] =
+   "Filename\t\t\t\tType\t\tSize\t\tUsed\t\tPriority\n"
+   "/dev/sda2                               partition\t8388604\t\t500000\t\t-2\n"
+   "/swapfile                               file\t\t8388608\t\t277212\t\t-3\n";
+
+static void
+fake_file(const char *name, const char *text)
+{
+   char path[PATH_MAX];
+   int  fd;
+
+   snprintf(path, sizeof(path), "%s/%s", fake_dir, name);
+   if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600)) == -1)
+      err(1, "%s", path);
+   if (write(fd, text, strlen(text)) != (ssize_t)strlen(text))
+      err(1, "%s: write", path);
+   close(fd);
+}
+
+static void
+fake_remove()
+{
+   char path[PATH_MAX];
+   int  i;
+
+   for (i = 0; i < 4; i++) {
+      snprintf(path, sizeof(path), "%s/%s", fake_dir, fake_names[i]);
+      unlink(path);
+   }
+   rmdir(fake_dir);
+}
+
+/* a /proc just good enough for sysinfo_init(), of CHECK_NCPU idle cpus */
+static void
+fake_procfs()
+{
+   char stat[CHECK_NCPU * 64 + 64], *p;
+   int  cpu;
+
+   if (mkdtemp(fake_dir) == NULL)
+      err(1, "mkdtemp");
+   atexit(fake_remove);
+
+   p = stat + sprintf(stat, "cpu  0 0 0 %d 0 0 0 0 0 0\n", CHECK_NCPU);
+   for (cpu = 0; cpu < CHECK_NCPU; cpu++)
+      p += sprintf(p, "cpu%d 0 0 0 1 0 0 0 0 0 0\n", cpu);
+   fake_file("stat", stat);
+   fake_file("meminfo", "MemTotal: 1000 kB\nMemFree: 500 kB\n");
+   fake_file("swaps", fake_swaps);
+   fake_file("loadavg", "0.00 0.00 0.00 1/1 1\n");
+
+   if (setenv("XSTATBAR_PROCFS", fake_dir, 1) == -1)
+      err(1, "setenv");
+}
+#endif
+
+/* a sample of the cpus, those in offline (a bit mask) without ticks */
+static void
+average_sample(uint64_t offline)
+{
+   uint64_t *cur, *prev;
+   int slot, cpu, state;
+
+   slot = cpu_sample_begin();
+   for (cpu = 0; cpu < sysinfo.ncpu; cpu++) {
+      cur  = CPU_RAW(slot, cpu);
+      prev = CPU_RAW(!slot, cpu);
+      for (state = 0; state < CPUSTATES; state++) {
+         cur[state] = prev[state];
+         if (cpu >= 64 || !(offline & (1ULL << cpu)))
+            cur[state] += check_rand() % 1000;
+      }
+   }
+   cpu_sample_end();
+}
+
+/* the newest average against the mean of the cpus that had ticks */
+static void
+average_check(const char *what)
+{
+   int cur, cpu, state, k, online, want, total;
+
+   cur = sysinfo.current;
+   for (state = 0; state < CPUSTATES; state++) {
+      online = want = 0;
+      for (cpu = 0; cpu < sysinfo.ncpu; cpu++) {
+         total = 0;
+         for (k = 0; k < CPUSTATES; k++)
+            total += CPU_HIST(cpu, k)[cur];
+         if (total == 0)
+            continue;
+         want += CPU_HIST(cpu, state)[cur];
+         online++;
+      }
+      want = online > 0 ? want / online : 0;
+      if (CPU_HIST(-1, state)[cur] != want)
+         errx(1, "average: %s: %d%% in state %d, not %d%%", what,
+            CPU_HIST(-1, state)[cur], state, want);
+   }
+}
+
+static void
+check_average()
+{
+   uint64_t offline;
+   int trial, state;
+
+   average_sample(0);
+   average_check("all cpus online");
+
+   /* every cpu but the first offline: the average is that cpu */
+   offline = ~1ULL;
+   average_sample(offline);
+   average_check("one cpu online");
+   for (state = 0; state < CPUSTATES; state++) {
+      if (CPU_HIST(-1, state)[sysinfo.current]
+      !=  CPU_HIST(0, state)[sysinfo.current])
+         errx(1, "average: one cpu online: not that cpu's");
+   }
+
+   average_sample(~0ULL);
+   average_check("all cpus offline");
+
+   for (trial = 0; trial < 1000; trial++) {
+      offline = check_rand();
+      average_sample(offline);
+      average_check("some cpus offline");
+   }
+
+   printf("average: %d cpus ok\n", sysinfo.ncpu);
+}
+
+static void
+check_layout()
+{
+   slot_t   slots[3];
+   layout_t l = { slots, 3, -1, false };
+   int      i, x;
+
+   /* a clock with room to spare, a widget over 100 pixels goes compact */
+   for (i = 0; i < 3; i++) {
+      memset(&slots[i], 0, sizeof(slot_t));
+      slots[i].widget = i;
+      slots[i].priority = 1;
+      slots[i].width[FORM_FULL] = slots[i].width[FORM_COMPACT] = -1;
+   }
+   slots[0].min = 60;
+   slots[1].max = 100;
+
+   layout_compute(&l, 400);
+   layout_fit(&l, &slots[0], 40);
+   layout_fit(&l, &slots[1], 80);
+   layout_fit(&l, &slots[2], 50);
+   if (!l.dirty)
+      errx(1, "layout: the first widths didn't lay the bar out");
+   layout_compute(&l, 400);
+   x = slots[1].x;
+
+   if (layout_fit(&l, &slots[0], 55) || layout_fit(&l, &slots[0], 60))
+      errx(1, "layout: a width within the min laid the bar out again");
+
+   if (!layout_fit(&l, &slots[0], 70))
+      errx(1, "layout: a width past the min didn't lay the bar out again");
+   layout_compute(&l, 400);
+   if (slots[1].x != x + 10)
+      errx(1, "layout: at %d, not %d, after the slot before grew by 10",
+         slots[1].x, x + 10);
+
+   if (!layout_fit(&l, &slots[1], 120))
+      errx(1, "layout: a width over the max didn't lay the bar out again");
+   layout_compute(&l, 400);
+   if (slots[1].form != FORM_COMPACT)
+      errx(1, "layout: a slot over its max isn't compact");
+
+   printf("layout: ok\n");
+}
+
+/* a memory sample of random numbers */
+static void
+mem_sample()
+{
+   int cur, k;
+
+   cur = mem_sample_begin();
+   for (k = 0; k < 3; k++)
+      MEM_HIST(k)[cur] = check_rand() % 1000000;
+   mem_sample_end();
+}
+
+/* a series of h, as hist_series() has it, in si's history of any size */
+static const int *
+resize_series(const sysinfo_t *si, const hist_t *h, int k, int kind, int s)
+{
+   if (k == 0)
+      return h->raw + s * si->hist_size;
+   return h->rollup + (((k - 1) * 3 + kind) * h->nseries + s) * si->hist_size;
+}
+
+/* every tier of h, in sysinfo, against oh, of old, before the resize */
+static void
+resize_compare(const char *what, const char *name, const sysinfo_t *old,
+               const hist_t *oh, const hist_t *h)
+{
+   const tier_t *ot, *t;
+   int k, kind, s, i, n, was, is;
+
+   for (k = 0; k < HIST_TIERS; k++) {
+      ot = &oh->tiers[k];
+      t  = &h->tiers[k];
+      if (t->buckets != ot->buckets || t->fill != ot->fill)
+         errx(1, "resize: %s: %s tier %d has %llu buckets (%d in the newest),"
+            " not %llu (%d)", what, name, k, (unsigned long long)t->buckets,
+            t->fill, (unsigned long long)ot->buckets, ot->fill);
+
+      n = (int)MIN((uint64_t)MIN(old->hist_size, sysinfo.hist_size),
+                   t->buckets);
+      for (i = 0; i < n; i++) {
+         for (kind = 0; kind < (k == 0 ? 1 : 3); kind++) {
+            for (s = 0; s < h->nseries; s++) {
+               was = resize_series(old, oh, k, kind, s)
+                  [(ot->current - i + old->hist_size) % old->hist_size];
+               is  = resize_series(&sysinfo, h, k, kind, s)
+                  [(t->current - i + sysinfo.hist_size) % sysinfo.hist_size];
+               if (is != was)
+                  errx(1, "resize: %s: %s tier %d, %d buckets back, series"
+                     " %d: %d, not %d", what, name, k, i, s, is, was);
+            }
+         }
+      }
+   }
+
+   if (memcmp(h->sums, oh->sums,
+              (HIST_TIERS - 1) * h->nseries * sizeof(int64_t)) != 0)
+      errx(1, "resize: %s: %s sums changed", what, name);
+}
+
+static void
+resize_check(const char *what, int hist_size)
+{
+   sysinfo_t old;
+   history_header_t header;
+   int newest[CPUSTATES], state, fd;
+
+   memset(&old, 0, sizeof(old));
+   sysinfo_sync(&old, &sysinfo);
+   sysinfo_resize(hist_size);
+
+   if (sysinfo.hist_size != hist_size || sysinfo.resizes != old.resizes + 1)
+      errx(1, "resize: %s: to %d samples, not %d", what, sysinfo.hist_size,
+         hist_size);
+   if (sysinfo.samples != old.samples
+   ||  sysinfo.mem_samples != old.mem_samples)
+      errx(1, "resize: %s: samples lost count", what);
+   resize_compare(what, "cpu", &old, &old.cpu_hist, &sysinfo.cpu_hist);
+   resize_compare(what, "memory", &old, &old.mem_hist, &sysinfo.mem_hist);
+   free(old.hist_block);
+
+   /* the history file was started over at the new size, with all that */
+   if (history_path != NULL) {
+      if ((fd = open(history_path, O_RDONLY)) == -1)
+         err(1, "resize: %s", history_path);
+      if (pread(fd, &header, sizeof(header), 0) != sizeof(header))
+         errx(1, "resize: %s: short read", history_path);
+      close(fd);
+      if (header.hist_size != hist_size
+      ||  header.current != sysinfo.current
+      ||  header.samples != sysinfo.samples
+      ||  header.mem_current != sysinfo.mem_current
+      ||  header.mem_samples != sysinfo.mem_samples
+      ||  header.cpu_time[0] == 0 || header.mem_time[0] == 0)
+         errx(1, "resize: %s: the history file's header is behind", what);
+   }
+
+   /* the next samples go right after the newest before */
+   for (state = 0; state < CPUSTATES; state++)
+      newest[state] = CPU_HIST(-1, state)[sysinfo.current];
+   average_sample(0);
+   average_check(what);
+   for (state = 0; state < CPUSTATES; state++) {
+      if (CPU_HIST(-1, state)[(sysinfo.current - 1 + hist_size) % hist_size]
+      !=  newest[state])
+         errx(1, "resize: %s: the next sample isn't after the newest", what);
+   }
+   mem_sample();
+}
+
+/* enough samples for a few buckets of the coarser tiers, then resize */
+static void
+check_resize(const char *where)
+{
+   int i;
+
+   for (i = 0; i < 1300; i++) {
+      average_sample(check_rand());
+      mem_sample();
+   }
+
+   resize_check("grown", sysinfo.hist_size * 3);
+   resize_check("shrunk", sysinfo.hist_size / 6);
+
+   printf("resize: %s ok\n", where);
+}
+
+/* the history file for the second round of check_resize() */
+static char history_file[] = "/tmp/xstatbar-check-history.XXXXXX";
+
+static void
+history_remove()
+{
+   unlink(history_file);
+}
+
+/*
+ * a mixer on a pipe: each change to it is a mixer_t written to mixer[1].
+ * the widget reads them on the sampler thread as volume_update() does the
+ * real one, and loses the mixer when the pipe is closed.
+ */
+typedef struct {
+   int   left, right;
+   bool  muted;
+} mixer_t;
+
+static int mixer[2] = { -1, -1 };
+static int mixer_updates = 0;       /* atomically */
+
+static void
+mixer_init()
+{
+   volume.is_setup = true;
+   volume.max = 255;
+   volume.nchan = 2;
+}
+
+static int
+mixer_fd()
+{
+   return volume.is_setup ? mixer[0] : -1;
+}
+
+static bool
+mixer_update()
+{
+   volume_info_t old = volume;
+   mixer_t m;
+   ssize_t n;
+
+   while ((n = read(mixer[0], &m, sizeof(m))) == sizeof(m)) {
+      volume.left  = m.left;
+      volume.right = m.right;
+      volume.muted = m.muted;
+   }
+   if (n == 0) {
+      close(mixer[0]);
+      volume.is_setup = false;
+   }
+   __atomic_add_fetch(&mixer_updates, 1, __ATOMIC_RELEASE);
+
+   return volume.is_setup != old.is_setup || volume.left != old.left
+       || volume.right != old.right || volume.muted != old.muted;
+}
+
+static void
+mixer_write(int left, int right, bool muted)
+{
+   mixer_t m = { left, right, muted };
+
+   if (write(mixer[1], &m, sizeof(m)) != sizeof(m))
+      err(1, "sampler: mixer write");
+}
+
+/* until the widget was updated that many times, or a few seconds */
+static void
+mixer_wait(int updates)
+{
+   int i;
+
+   for (i = 0; i < 5000; i++) {
+      if (__atomic_load_n(&mixer_updates, __ATOMIC_ACQUIRE) >= updates)
+         return;
+      usleep(1000);
+   }
+   errx(1, "sampler: the mixer widget wasn't updated on its fd");
+}
+
+/* the next snapshot, which has to come within a few seconds */
+static void
+sampler_next(const char *what)
+{
+   struct pollfd pfd;
+
+   pfd.fd = sampler_fd();
+   pfd.events = POLLIN;
+   if (poll(&pfd, 1, 5000) != 1 || !sampler_read())
+      errx(1, "sampler: %s wasn't published", what);
+}
+
+static void
+volume_check(const char *what, int left, int right, bool muted)
+{
+   if (!volume.is_setup || volume.left != left || volume.right != right
+   ||  volume.muted != muted)
+      errx(1, "sampler: %s: volume %d/%d%s, not %d/%d%s", what, volume.left,
+         volume.right, volume.muted ? " muted" : "", left, right,
+         muted ? " muted" : "");
+}
+
+static void
+check_sampler()
+{
+   widget_t w;
+   unsigned long published;
+   int updates;
+
+   memset(&w, 0, sizeof(w));
+   w.name    = "volume";
+   w.enabled = true;
+   w.period  = 1000;
+   w.init    = mixer_init;
+   w.update  = mixer_update;
+   w.fd      = mixer_fd;
+
+   if (pipe(mixer) == -1)
+      err(1, "pipe");
+   if (fcntl(mixer[0], F_SETFL, O_NONBLOCK) == -1)
+      err(1, "fcntl");
+
+   /* nothing is scheduled: the first snapshot can only come from the fd */
+   mixer_write(100, 150, false);
+   sampler_start(&w, 1, 8);
+   if (!sampler_read())
+      errx(1, "sampler: no first snapshot");
+   volume_check("first", 100, 150, false);
+
+   mixer_write(30, 30, true);
+   sampler_next("a change");
+   volume_check("a change", 30, 30, true);
+
+   /* the same again is an update, but nothing new to publish */
+   published = PROFILE_GET(profile.publishes);
+   updates = __atomic_load_n(&mixer_updates, __ATOMIC_ACQUIRE);
+   mixer_write(30, 30, true);
+   mixer_wait(updates + 1);
+   mixer_write(30, 40, true);
+   sampler_next("a change after none");
+   volume_check("a change after none", 30, 40, true);
+   if (PROFILE_GET(profile.publishes) != published + 1)
+      errx(1, "sampler: a write that changed nothing was published");
+
+   /* the mixer goes away: published once, then its fd is dropped */
+   updates = __atomic_load_n(&mixer_updates, __ATOMIC_ACQUIRE);
+   close(mixer[1]);
+   sampler_next("losing the mixer");
+   if (volume.is_setup)
+      errx(1, "sampler: the mixer is still set up after it went away");
+   usleep(100000);
+   if (__atomic_load_n(&mixer_updates, __ATOMIC_ACQUIRE) != updates + 1)
+      errx(1, "sampler: the mixer's fd wasn't dropped once it was -1");
+
+   sampler_stop();
+   printf("sampler: ok\n");
+}
+
+#ifdef __OpenBSD__
+/*
+ * swapctl(2) and reallocarray(3) as swap_update() sees them: a table of
+ * fake devices, of which SWAP_STATS fills in the first swap_filled (less
+ * than SWAP_NSWAP says if some went away in between), and a count of the
+ * allocations
+ */
+static struct swapent swap_devs[4];
+static int            swap_ndevs = 0, swap_filled = 0;
+static int            allocs = 0;
+
+int
+swapctl(int cmd, const void *arg, int misc)
+{
+   int n;
+
+   switch (cmd) {
+      case SWAP_NSWAP:
+         return swap_ndevs;
+      case SWAP_STATS:
+         n = MIN(misc, swap_filled);
+         memcpy((void *)arg, swap_devs, n * sizeof(struct swapent));
+         return n;
+   }
+
+   errno = EINVAL;
+   return -1;
+}
+
+void *
+reallocarray(void *p, size_t n, size_t size)
+{
+   if (size != 0 && n > SIZE_MAX / size) {
+      errno = ENOMEM;
+      return NULL;
+   }
+   allocs++;
+   return realloc(p, n * size);
+}
+
+/* device i, of nblks blocks with inuse of them used */
+static void
+swap_dev(int i, int nblks, int inuse, bool enabled)
+{
+   swap_devs[i].se_nblks = nblks;
+   swap_devs[i].se_inuse = inuse;
+   swap_devs[i].se_flags = enabled ? SWF_ENABLE : 0;
+}
+
+/* swap_update() of ndevs, filled of them, allocating as much as said */
+static void
+swap_check(const char *what, int ndevs, int filled, int want_allocs,
+   int used, int total)
+{
+   allocs = 0;
+   swap_ndevs = ndevs;
+   swap_filled = filled;
+   swap_update();
+   if (allocs > want_allocs)
+      errx(1, "swap: %s: %d allocations, not %d", what, allocs, want_allocs);
+   if (sysinfo.swap_used != used || sysinfo.swap_total != total)
+      errx(1, "swap: %s: %d/%d kB, not %d/%d kB", what, sysinfo.swap_used,
+         sysinfo.swap_total, used, total);
+}
+
+static void
+check_swap()
+{
+   int i;
+
+   /* the blocks are DEV_BSIZE (512) bytes, the sizes in kB */
+   swap_dev(0, 2048, 512, true);
+   swap_dev(1, 4096, 1024, true);
+   swap_dev(2, 8192, 8192, false);
+   swap_dev(3, 1024, 1024, true);
+
+   swap_check("first sample", 3, 3, 1, 768, 3072);
+   for (i = 0; i < 100; i++)
+      swap_check("same devices", 3, 3, 0, 768, 3072);
+   swap_check("one went away", 3, 1, 0, 256, 1024);
+   swap_check("fewer devices", 1, 1, 0, 256, 1024);
+   swap_check("more devices", 4, 4, 1, 1280, 3584);
+   swap_check("same again", 4, 4, 0, 1280, 3584);
+
+   printf("swap: ok\n");
+}
+#else
+/* Linux: the fake /proc's swaps */
+static void
+check_swap()
+{
+   swap_update();
+   if (sysinfo.swap_used != 777212 || sysinfo.swap_total != 16777212)
+      errx(1, "swap: %d/%d kB, not 777212/16777212 kB", sysinfo.swap_used,
+         sysinfo.swap_total);
+
+   printf("swap: ok\n");
+}
+#endif
+
+
+int
+main(int argc, char *argv[])
+{
+   int i;
+
+   check_ticks();
+   check_spans();
+   check_layout();
+
+#ifdef __linux__
+   fake_procfs();
+#endif
+   sysinfo_init(8);
+   check_average();
+   check_swap();
+   check_resize("in memory");
+   sysinfo_close();
+
+   /* and again, with the history mapped from a file */
+   if ((i = mkstemp(history_file)) == -1)
+      err(1, "mkstemp");
+   close(i);
+   atexit(history_remove);
+   history_path = history_file;
+   sysinfo_init(8);
+   check_resize("in a history file");
+   sysinfo_close();
+
+   history_path = NULL;
+   check_sampler();
+   return 0;
+}
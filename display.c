@@ -0,0 +1,871 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <err.h>
+
+#include "xstatbar.h"
+#include "stats.h"
+#include "widget.h"
+#include "render.h"
+#include "layout.h"
+#include "profile.h"
+#include "raster.h"
+#include "sampler.h"
+
+/*
+ * The X side of xstatbar: the window, its resources and colors, the
+ * events it gets, and drawing the bar into it.
+ */
+
+/* extern's from xstatbar.h */
+xinfo_t  XINFO;
+
+XftColor COLOR0, COLOR1, COLOR2, COLOR3,
+         COLOR4, COLOR5, COLOR6, COLOR7;
+
+
+char *bar_outputs = NULL;
+const char *bar_layout = NULL;
+
+/* local functions */
+void set_struts(bar_t *b, int output_y, int output_h);
+void resize_frame(bar_t *b);
+void present();
+static struct damage_state *damage_new();
+static void damage_free(struct damage_state *ds);
+
+/* get resource from X Resource database */
+const char *
+get_resource(const char *resource)
+{
+  static char name[256], class[256], *type;
+  XrmValue value = { 0, NULL };
+
+  if (!XINFO.xrdb)
+    return NULL;
+#define RESCLASS "xstatbar"
+#define RESNAME "XStatBar"
+  snprintf(name, sizeof(name), "%s.%s", RESNAME, resource);
+  snprintf(class, sizeof(class), "%s.%s", RESCLASS, resource);
+  XrmGetResource(XINFO.xrdb, name, class, &type, &value);
+  if (value.addr)
+    return value.addr;
+  return NULL;
+}
+
+XRenderColor*
+hex_to_color(const char *hex)
+{
+  if (strlen(hex) < 7) {
+    return NULL;
+  } 
+
+  XRenderColor *color = malloc(sizeof(XRenderColor));
+  long number = strtoll( &hex[1], NULL, 16);
+  long r = number >> 16;
+  long g = number >> 8 & 0xFF;
+  long b = number & 0xFF;
+
+
+  color->red = ((r + 1) * 64 * 16) - 1;
+  color->green = ((g + 1) * 64 * 16) - 1;
+  color->blue = ((b + 1) * 64 * 16) - 1;
+  color->alpha = 0xffff;
+
+  return color;
+}
+
+void
+calc_color(const char *name, XRenderColor *def, XftColor *col)
+{
+  const char *color;
+  color = get_resource(name);
+  XftColor lookup_color;
+  XRenderColor *hex_color;
+
+  if (color) {
+    if (color[0] == '#') {
+      hex_color = hex_to_color(color);
+      if (XftColorAllocValue(XINFO.disp, 
+            XINFO.vis, 
+            DefaultColormap( XINFO.disp, XINFO.screen ), 
+            hex_color, 
+            &lookup_color) ) {
+        *col = lookup_color;
+        return;
+      }
+     } else {
+      if (XftColorAllocName(XINFO.disp, 
+            XINFO.vis, 
+            DefaultColormap( XINFO.disp, XINFO.screen ), 
+            color, 
+            &lookup_color) ) {
+        *col = lookup_color;
+        return;
+      } else {
+      }
+    }
+  }
+
+  XftColorAllocValue(XINFO.disp, XINFO.vis, DefaultColormap( XINFO.disp, XINFO.screen ), def, col);
+}
+
+/* setup all colors used */
+void
+setup_colors()
+{
+  XRenderColor color0  = { .red = 0x0,    .green = 0x0,    .blue = 0x0,    .alpha = 0xffff };
+  XRenderColor color1  = { .red = 0xffff, .green = 0x0,    .blue = 0x0,    .alpha = 0xffff };
+  XRenderColor color2  = { .red = 0x0,    .green = 0xf000, .blue = 0x0,    .alpha = 0xffff };
+  XRenderColor color3  = { .red = 0xffff, .green = 0xffff, .blue = 0x0,    .alpha = 0xffff };
+  XRenderColor color4  = { .red = 0x0,    .green = 0x0,    .blue = 0xffff, .alpha = 0xffff };
+  XRenderColor color5  = { .red = 0xffff, .green = 0x0,    .blue = 0xffff, .alpha = 0xffff };
+  XRenderColor color6  = { .red = 0x0,    .green = 0xffff, .blue = 0xffff, .alpha = 0xffff };
+  XRenderColor color7  = { .red = 0xffff, .green = 0xffff, .blue = 0xffff, .alpha = 0xffff };
+
+  calc_color("color0", &color0, &COLOR0);
+  calc_color("color1", &color1, &COLOR1);
+  calc_color("color2", &color2, &COLOR2);
+  calc_color("color3", &color3, &COLOR3);
+  calc_color("color4", &color4, &COLOR4);
+  calc_color("color5", &color5, &COLOR5);
+  calc_color("color6", &color6, &COLOR6);
+  calc_color("color7", &color7, &COLOR7);
+}
+
+int
+calculate_width_of_default_screen()
+{
+  int nsizes;
+  XRRScreenSize* randrsize = XRRSizes(XINFO.disp, XINFO.screen, &nsizes);
+
+  if (nsizes != 0) {
+    Rotation current = 0;
+    XRRScreenConfiguration * sc;
+
+    sc = XRRGetScreenInfo (XINFO.disp, RootWindow (XINFO.disp, XINFO.screen));
+    int current_size = XRRConfigCurrentConfiguration (sc, &current);
+    XRRFreeScreenConfigInfo(sc);
+
+    if (current_size < nsizes) {
+
+      XRRRotations(XINFO.disp, XINFO.screen, &current);
+      randrsize += current_size;
+
+      bool rot = current & RR_Rotate_90 || current & RR_Rotate_270;
+      return rot ? randrsize->height : randrsize->width;
+    }
+  }
+  return DisplayWidth(XINFO.disp, XINFO.screen);
+}
+
+/* reserve a bar's area of the screen with the window manager */
+void
+set_struts(bar_t *b, int output_y, int output_h)
+{
+  unsigned long struts[12];
+
+  bzero(struts, sizeof(struts));
+  enum { left, right, top, bottom, left_start_y, left_end_y, right_start_y,
+    right_end_y, top_start_x, top_end_x, bottom_start_x, bottom_end_x };
+  if (b->y - output_y <= output_h/2) {
+    struts[top] = b->y + XINFO.height;
+    struts[top_start_x] = b->x;
+    struts[top_end_x] = b->x + b->width - 1;
+  } else {
+    struts[bottom] = DisplayHeight(XINFO.disp, XINFO.screen) - b->y;
+    struts[bottom_start_x] = b->x;
+    struts[bottom_end_x] = b->x + b->width - 1;
+  }
+  XChangeProperty(XINFO.disp, b->win, XInternAtom(XINFO.disp, "_NET_WM_STRUT_PARTIAL", False),
+       XA_CARDINAL, 32, PropModeReplace, (unsigned char*)struts, 12);
+}
+
+/*
+ * (re)create a bar's frame pixmap at its window's current size, and the
+ * raster buffer (which all bars share) at the widest's
+ */
+void
+resize_frame(bar_t *b)
+{
+  bar_t *o;
+  unsigned int widest = 0;
+
+  if (b->frame != None)
+    XFreePixmap(XINFO.disp, b->frame);
+
+  b->frame = XCreatePixmap(XINFO.disp, b->win, b->width, XINFO.height,
+                           XINFO.depth);
+  XSetWindowBackgroundPixmap(XINFO.disp, b->win, b->frame);
+
+  if (b->xftdraw == NULL)
+    b->xftdraw = XftDrawCreate(XINFO.disp, b->frame,
+                               DefaultVisual(XINFO.disp,XINFO.screen),
+                               DefaultColormap( XINFO.disp, XINFO.screen ) );
+  else
+    XftDrawChange(b->xftdraw, b->frame);
+
+  for (o = XINFO.bars; o != NULL; o = o->next)
+    widest = MAX(widest, o->width);
+  raster_resize(widest, XINFO.height);
+
+  draw_invalidate();
+}
+
+/* a new bar, at x, y on the screen and width wide */
+static bar_t *
+bar_create(const char *output, int x, int y, unsigned int width)
+{
+  XSetWindowAttributes x11_window_attributes;
+  Atom type;
+  bar_t *b;
+
+  if ((b = calloc(1, sizeof(bar_t))) == NULL)
+    err(1, "bar calloc failed");
+  b->damage = damage_new();
+  b->layout = layout_new();
+  strlcpy(b->output, output, sizeof(b->output));
+  b->x = x;
+  b->y = y;
+  b->width = width;
+  b->frame = None;
+  x11_window_attributes.override_redirect = 1;
+
+  /* create window */
+  b->win = XCreateWindow(
+    XINFO.disp, DefaultRootWindow(XINFO.disp),
+    x, y,
+    b->width, XINFO.height,
+    1,
+    CopyFromParent, InputOutput, XINFO.vis,
+    CWOverrideRedirect, &x11_window_attributes
+  );
+
+  /* setup window manager hints */
+  type = XInternAtom(XINFO.disp, "_NET_WM_WINDOW_TYPE_DOCK", False);
+  XChangeProperty(XINFO.disp, b->win, XInternAtom(XINFO.disp, "_NET_WM_WINDOW_TYPE", False),
+       XA_ATOM, 32, PropModeReplace, (unsigned char*)&type, 1);
+
+  /* events: exposures and resizes */
+  XSelectInput(XINFO.disp, b->win, ExposureMask | StructureNotifyMask);
+
+  b->next = XINFO.bars;
+  XINFO.bars = b;
+  resize_frame(b);
+
+  /* connect window to display */
+  XMapWindow(XINFO.disp, b->win);
+  XMoveWindow(XINFO.disp, b->win, x, y);
+  return b;
+}
+
+static void
+bar_destroy(bar_t *b)
+{
+  XftDrawDestroy(b->xftdraw);
+  XFreePixmap(XINFO.disp, b->frame);
+  XDestroyWindow(XINFO.disp, b->win);
+  damage_free(b->damage);
+  layout_free(b->layout);
+  free(b);
+}
+
+/* whether the -O list has the output (or there is no list) */
+static bool
+output_wanted(const char *name)
+{
+  const char *p = bar_outputs;
+  size_t len = strlen(name);
+
+  if (p == NULL)
+    return true;
+
+  while (*p != '\0') {
+    if (strncmp(p, name, len) == 0 && (p[len] == ',' || p[len] == '\0'))
+      return true;
+    if ((p = strchr(p, ',')) == NULL)
+      break;
+    p++;
+  }
+  return false;
+}
+
+/*
+ * there is a bar on the output at ox, oy, ow x oh: find (or make) it,
+ * and move it to where it belongs on that output
+ */
+static void
+bar_place(const char *output, int ox, int oy, unsigned int ow, unsigned int oh)
+{
+  bar_t *b;
+  int x = ox + XINFO.x;
+  int y = oy + XINFO.y;
+  unsigned int width = XINFO.fixed_width ? XINFO.fixed_width : ow;
+
+  for (b = XINFO.bars; b != NULL; b = b->next) {
+    if (!b->seen && strcmp(b->output, output) == 0)
+      break;
+  }
+
+  if (b == NULL)
+    b = bar_create(output, x, y, width);
+  else if (b->x != x || b->y != y || b->width != width) {
+    b->x = x;
+    b->y = y;
+    b->width = width;
+    XMoveResizeWindow(XINFO.disp, b->win, x, y, width, XINFO.height);
+    resize_frame(b);
+  }
+
+  set_struts(b, oy, oh);
+  b->seen = true;
+}
+
+/*
+ * (re)scan the outputs: a bar on each that is connected and lit (once
+ * for outputs mirroring each other), none on the others.  without RandR
+ * 1.2 there is one bar, on the whole screen.
+ */
+static void
+scan_outputs()
+{
+  XRRScreenResources *res = NULL;
+  XRROutputInfo *out;
+  XRRCrtcInfo *crtc;
+  RRCrtc *used = NULL;
+  bar_t *b, **bp;
+  int i, j, nused = 0;
+  bool any = false;
+
+  for (b = XINFO.bars; b != NULL; b = b->next)
+    b->seen = false;
+
+  if (XINFO.randr_outputs)
+    res = XRRGetScreenResourcesCurrent(XINFO.disp,
+                                       RootWindow(XINFO.disp, XINFO.screen));
+  if (res != NULL && (used = calloc(res->ncrtc + 1, sizeof(RRCrtc))) == NULL)
+    err(1, "scan outputs: calloc failed");
+
+  for (i = 0; res != NULL && i < res->noutput; i++) {
+    if ((out = XRRGetOutputInfo(XINFO.disp, res, res->outputs[i])) == NULL)
+      continue;
+
+    for (j = 0; j < nused && used[j] != out->crtc; j++)
+      ;
+    if (out->connection == RR_Connected && out->crtc != None && j == nused
+    &&  output_wanted(out->name)
+    &&  (crtc = XRRGetCrtcInfo(XINFO.disp, res, out->crtc)) != NULL) {
+      bar_place(out->name, crtc->x, crtc->y, crtc->width, crtc->height);
+      used[nused++] = out->crtc;
+      any = true;
+      XRRFreeCrtcInfo(crtc);
+    }
+    XRRFreeOutputInfo(out);
+  }
+
+  if (res != NULL) {
+    XRRFreeScreenResources(res);
+    free(used);
+  }
+
+  /* -O only ever means outputs; without a list, there is always a bar */
+  if (!any && (bar_outputs == NULL || !XINFO.randr_outputs))
+    bar_place("", 0, 0, calculate_width_of_default_screen(),
+              DisplayHeight(XINFO.disp, XINFO.screen));
+
+  for (bp = &XINFO.bars; (b = *bp) != NULL; ) {
+    if (b->seen)
+      bp = &b->next;
+    else {
+      *bp = b->next;
+      bar_destroy(b);
+    }
+  }
+}
+
+/*
+ * the graphs' width and window, from the resources unless they were given
+ * as -g and -G.  if that changes the history they need, the sampler is
+ * told to keep that much, which it does without losing any.
+ */
+static void
+graph_resources()
+{
+  const char *s;
+  char *end;
+  double secs;
+  long width;
+  int hist = graphs_hist_size();
+
+  if (!graph_width_fixed && (s = get_resource("graphWidth")) != NULL) {
+    width = strtol(s, &end, 10);
+    if (end == s || *end != '\0' || width < 1 || width > INT_MAX)
+      warnx("illegal graphWidth \"%s\"", s);
+    else
+      graph_width = width;
+  }
+
+  if (!graph_window_fixed && (s = get_resource("graphWindow")) != NULL) {
+    secs = strtod(s, &end);
+    if (end == s || *end != '\0' || secs < 0.001 || secs > INT_MAX / 1000)
+      warnx("illegal graphWindow \"%s\"", s);
+    else
+      graphs_window((int)(secs * 1000 + 0.5));
+  }
+
+  if (graphs_hist_size() != hist)
+    sampler_resize(graphs_hist_size());
+  graph_invalidate_all();
+}
+
+/*
+ * xrdb(1) changed the resources: take them up again.  only the graphs
+ * follow; the colors, font and layout stay as they were at startup.
+ */
+static void
+reload_resources()
+{
+  XrmDatabase old = XINFO.xrdb;
+  unsigned char *data = NULL;
+  unsigned long n, after;
+  Atom type;
+  int format;
+
+  XINFO.xrdb = NULL;
+  if (XGetWindowProperty(XINFO.disp, RootWindow(XINFO.disp, XINFO.screen),
+                         XA_RESOURCE_MANAGER, 0, 100000000L, False, XA_STRING,
+                         &type, &format, &n, &after, &data) == Success
+  &&  data != NULL)
+    XINFO.xrdb = XrmGetStringDatabase((char *)data);
+  if (data != NULL)
+    XFree(data);
+
+  /* the display may hold the old one (see setup_x()) */
+  if (old != NULL && XrmGetDatabase(XINFO.disp) == old)
+    XrmSetDatabase(XINFO.disp, XINFO.xrdb);
+  XrmDestroyDatabase(old);
+
+  graph_resources();
+  draw_invalidate();
+}
+
+/* the bar with the given window, if any */
+static bar_t *
+bar_find(Window win)
+{
+  bar_t *b;
+
+  for (b = XINFO.bars; b != NULL; b = b->next) {
+    if (b->win == win)
+      return b;
+  }
+  return NULL;
+}
+
+/*
+ * handle all pending X events.  returns true if the bars need to be
+ * redrawn right away.
+ */
+bool
+process_events()
+{
+  XEvent ev;
+  bar_t *b;
+  bool redraw = false;
+
+  while (XPending(XINFO.disp)) {
+    XNextEvent(XINFO.disp, &ev);
+
+    if (ev.type == Expose) {
+      /* repaint straight from the frame */
+      if ((b = bar_find(ev.xexpose.window)) != NULL)
+        XCopyArea(XINFO.disp, b->frame, b->win, XINFO.gc,
+                  ev.xexpose.x, ev.xexpose.y,
+                  ev.xexpose.width, ev.xexpose.height,
+                  ev.xexpose.x, ev.xexpose.y);
+    } else if (ev.type == ConfigureNotify) {
+      b = bar_find(ev.xconfigure.window);
+      if (b != NULL && (unsigned int)ev.xconfigure.width != b->width) {
+        b->width = ev.xconfigure.width;
+        resize_frame(b);
+        redraw = true;
+      }
+    } else if (XINFO.randr_event != -1
+           &&  (ev.type == XINFO.randr_event + RRScreenChangeNotify
+           ||   ev.type == XINFO.randr_event + RRNotify)) {
+      /* an output was plugged in or out, or changed mode */
+      XRRUpdateConfiguration(&ev);
+      scan_outputs();
+      redraw = true;
+    } else if (ev.type == PropertyNotify
+           &&  ev.xproperty.atom == XA_RESOURCE_MANAGER) {
+      reload_resources();
+      redraw = true;
+    }
+  }
+
+  return redraw;
+}
+
+/* setup x, and a bar on every output */
+void
+setup_x(int x, int y, int w, int h, const char *font)
+{
+  char *xrms = NULL;
+  int randr_error, major, minor;
+
+  /* open display */
+  if (!(XINFO.disp = XOpenDisplay(NULL)))
+      errx(1, "can't open X11 display.");
+  /* initialize resource manager */
+  XrmInitialize();
+  /* setup various defaults/settings */
+  XINFO.screen = DefaultScreen(XINFO.disp);
+  XINFO.height = h;
+  XINFO.depth  = DefaultDepth(XINFO.disp, XINFO.screen);
+  XINFO.vis    = DefaultVisual(XINFO.disp, XINFO.screen);
+  XINFO.fixed_width = w;
+  XINFO.x      = x;
+  XINFO.y      = y;
+  XINFO.bars   = NULL;
+
+  if(!(XINFO.xrdb = XrmGetDatabase(XINFO.disp))) {
+    xrms = XResourceManagerString(XINFO.disp);
+    if (xrms)
+      XINFO.xrdb = XrmGetStringDatabase(xrms);
+
+  }
+
+  /* everything is drawn into the frames, which also back the windows */
+  XINFO.gc = XCreateGC(XINFO.disp, RootWindow(XINFO.disp, XINFO.screen), 0, NULL);
+  XSetGraphicsExposures(XINFO.disp, XINFO.gc, False);
+  if (raster_enabled)
+    raster_init();
+
+  /* events: screen (randr) changes, and outputs coming and going */
+  XINFO.randr_outputs = false;
+  if (XRRQueryExtension(XINFO.disp, &XINFO.randr_event, &randr_error)) {
+    XINFO.randr_outputs = XRRQueryVersion(XINFO.disp, &major, &minor)
+                       && (major > 1 || (major == 1 && minor >= 2));
+    XRRSelectInput(XINFO.disp, RootWindow(XINFO.disp, XINFO.screen),
+                   RRScreenChangeNotifyMask
+                   | (XINFO.randr_outputs ? RROutputChangeNotifyMask
+                                          | RRCrtcChangeNotifyMask : 0));
+  } else
+    XINFO.randr_event = -1;
+
+  /* and the resources changing (xrdb(1)), for the graphs */
+  XSelectInput(XINFO.disp, RootWindow(XINFO.disp, XINFO.screen),
+               PropertyChangeMask);
+
+  /* setup font */
+  XINFO.font = XftFontOpenName(XINFO.disp, XINFO.screen, font); 
+  if (!XINFO.font)
+    errx(1, "XLoadQueryFont failed for \"%s\"", font);
+
+  setup_colors();
+
+  /* the layout of the bars, before there are any */
+  if (bar_layout == NULL && (bar_layout = get_resource("layout")) == NULL)
+    bar_layout = LAYOUT_DEFAULT;
+  layout_init(bar_layout);
+  graph_resources();
+
+  scan_outputs();
+}
+
+/* x teardown */
+void
+close_x()
+{
+  bar_t *b;
+
+  graph_close_all();
+  batch_close();
+  raster_close();
+  while ((b = XINFO.bars) != NULL) {
+    XINFO.bars = b->next;
+    bar_destroy(b);
+  }
+  XFreeGC(XINFO.disp, XINFO.gc);
+  XrmDestroyDatabase(XINFO.xrdb);
+
+  XftColorFree(XINFO.disp, XINFO.vis, DefaultColormap( XINFO.disp, XINFO.screen ), &COLOR0);
+  XftColorFree(XINFO.disp, XINFO.vis, DefaultColormap( XINFO.disp, XINFO.screen ), &COLOR1);
+  XftColorFree(XINFO.disp, XINFO.vis, DefaultColormap( XINFO.disp, XINFO.screen ), &COLOR2);
+  XftColorFree(XINFO.disp, XINFO.vis, DefaultColormap( XINFO.disp, XINFO.screen ), &COLOR3);
+  XftColorFree(XINFO.disp, XINFO.vis, DefaultColormap( XINFO.disp, XINFO.screen ), &COLOR4);
+  XftColorFree(XINFO.disp, XINFO.vis, DefaultColormap( XINFO.disp, XINFO.screen ), &COLOR5);
+  XftColorFree(XINFO.disp, XINFO.vis, DefaultColormap( XINFO.disp, XINFO.screen ), &COLOR6);
+  XftColorFree(XINFO.disp, XINFO.vis, DefaultColormap( XINFO.disp, XINFO.screen ), &COLOR7);
+
+  XCloseDisplay(XINFO.disp);
+}
+
+/*
+ * damage tracking.  every widget remembers a hash of the state it last
+ * drew and where it drew it, on each bar; if neither changed the widget is
+ * skipped.  a bar's frame pixmap keeps everything that was drawn, and only
+ * the damaged spans of it are copied to its window.
+ */
+typedef struct {
+   bool           drawn;
+   unsigned long  hash;     /* hash of the state last drawn */
+   int            x;        /* where the widget was asked to draw */
+   int            rx, rw;   /* the region it actually covered */
+} damage_t;
+
+#define MAX_SPANS 8
+struct damage_state {
+   damage_t     **parts;        /* [nwidgets][nparts] */
+   struct { int x, w; } spans[MAX_SPANS];
+   int            nspans;
+   bool           redraw_all;   /* ignore all hashes on the next frame */
+   int            clear_from;   /* the frame is already clear from here on */
+};
+
+/* the state of the bar being drawn */
+#define DS (XINFO.bar->damage)
+
+/* one slot per part of each widget */
+static struct damage_state *
+damage_new()
+{
+   struct damage_state *ds;
+   int i;
+
+   if ((ds = calloc(1, sizeof(*ds))) == NULL
+   ||  (ds->parts = calloc(nwidgets, sizeof(damage_t *))) == NULL)
+      err(1, "draw: damage calloc failed");
+   for (i = 0; i < nwidgets; i++) {
+      ds->parts[i] = calloc(widget_nparts(&widgets[i]), sizeof(damage_t));
+      if (ds->parts[i] == NULL)
+         err(1, "draw: damage calloc failed");
+   }
+   ds->redraw_all = true;
+   return ds;
+}
+
+static void
+damage_free(struct damage_state *ds)
+{
+   int i;
+
+   for (i = 0; i < nwidgets; i++)
+      free(ds->parts[i]);
+   free(ds->parts);
+   free(ds);
+}
+
+/* mark [x, x + w) as needing to be copied to the window */
+static void
+damage_add(int x, int w)
+{
+   int i;
+
+   if (w <= 0)
+      return;
+
+   for (i = 0; i < DS->nspans; i++) {
+      if (x <= DS->spans[i].x + DS->spans[i].w && DS->spans[i].x <= x + w)
+         break;
+   }
+
+   if (i == DS->nspans) {
+      if (DS->nspans == MAX_SPANS)
+         i = DS->nspans - 1;
+      else {
+         DS->spans[DS->nspans].x = x;
+         DS->spans[DS->nspans].w = w;
+         DS->nspans++;
+         return;
+      }
+   }
+
+   /* merge into an overlapping span (or the last one, if out of room) */
+   w = MAX(x + w, DS->spans[i].x + DS->spans[i].w);
+   DS->spans[i].x = MIN(x, DS->spans[i].x);
+   DS->spans[i].w = w - DS->spans[i].x;
+}
+
+static void
+clear_area(int x, int w)
+{
+   if (w > 0)
+      XftDrawRect(XINFO.bar->xftdraw, &COLOR0, x, 0, w, XINFO.height);
+}
+
+/* should the widget be drawn at x?  if so, wipe what it drew last time */
+static bool
+damage_begin(damage_t *d, unsigned long hash, int x)
+{
+   bool wiped = d->rx + d->rw > DS->clear_from;
+
+   if (d->drawn && !wiped && d->hash == hash && d->x == x)
+      return false;
+
+   if (d->drawn && !wiped)
+      clear_area(d->rx, d->rw);
+   return true;
+}
+
+/*
+ * a widget drew [rx, rx + rw).  where it goes is up to the layout, which
+ * has everything redrawn when a widget's width changes (see draw_bar()),
+ * so nothing else moves here.
+ */
+static void
+damage_end(damage_t *d, unsigned long hash, int x, int rx, int rw)
+{
+   if (d->drawn)
+      damage_add(d->rx, d->rw);
+   damage_add(rx, rw);
+
+   d->drawn = true;
+   d->hash  = hash;
+   d->x     = x;
+   d->rx    = rx;
+   d->rw    = rw;
+}
+
+/* force every widget to be redrawn on the next frame, on every bar */
+void
+draw_invalidate()
+{
+   bar_t *b;
+
+   for (b = XINFO.bars; b != NULL; b = b->next)
+      b->damage->redraw_all = true;
+}
+
+/* copy the damaged parts of the frame to the window */
+void
+present()
+{
+   int i;
+
+   for (i = 0; i < DS->nspans; i++) {
+      XCopyArea(XINFO.disp, XINFO.bar->frame, XINFO.bar->win, XINFO.gc,
+         DS->spans[i].x, 0, DS->spans[i].w, XINFO.height, DS->spans[i].x, 0);
+   }
+   DS->nspans = 0;
+}
+
+/*
+ * how many times a frame may be laid out again for widths that changed
+ * while drawing it, before what's there is shown anyway
+ */
+#define LAYOUT_PASSES 4
+
+/* draw all stats onto the bar being drawn */
+static void
+draw_bar()
+{
+   layout_t *l = XINFO.bar->layout;
+   unsigned long hash;
+   widget_t *wd;
+   damage_t *d;
+   slot_t *s;
+   int y, w;
+   int i, part, pass;
+
+   /* determine y */
+   y = XINFO.height - XINFO.font->descent;
+
+   for (pass = 0; pass < LAYOUT_PASSES; pass++) {
+      /*
+       * a new layout moves everything, so it is all redrawn.  the text of
+       * a pass before is wiped below, but its rectangles, graph copies and
+       * rasterized pixels are still queued at the old places: drop them.
+       */
+      if (l->dirty || l->width != (int)XINFO.bar->width) {
+         layout_compute(l, XINFO.bar->width);
+         batch_discard(XINFO.bar->xftdraw);
+         graph_discard();
+         raster_discard();
+         DS->redraw_all = true;
+      }
+
+      DS->clear_from = XINFO.bar->width;
+      if (DS->redraw_all) {
+         for (i = 0; i < nwidgets; i++) {
+            for (part = 0; part < widget_nparts(&widgets[i]); part++)
+               DS->parts[i][part].drawn = false;
+         }
+         clear_area(0, XINFO.bar->width);
+         damage_add(0, XINFO.bar->width);
+         DS->clear_from = 0;
+         DS->redraw_all = false;
+      }
+
+      /* draw every slot, unless nothing about it changed */
+      for (i = 0; i < l->nslots; i++) {
+         s = &l->slots[i];
+         if (s->form == FORM_HIDDEN)
+            continue;
+
+         wd = &widgets[s->widget];
+         d = &DS->parts[s->widget][s->part];
+         hash = wd->hash(s->part);
+         if (damage_begin(d, hash, s->x)) {
+            w = widget_draw(wd, s->part, s->form == FORM_COMPACT, s->x, y);
+            damage_end(d, hash, s->x, s->x, w);
+            layout_fit(l, s, w);
+         }
+      }
+
+      if (!l->dirty)
+         break;
+   }
+
+   /*
+    * send the batched rectangles, then the graphs that needed them, then
+    * whatever was rasterized client side
+    */
+   batch_flush();
+   graph_flush();
+   raster_flush();
+   present();
+}
+
+/* draw all stats, on every bar */
+void
+draw()
+{
+   static unsigned long resizes = 0;
+   unsigned long first_request;
+   long long start = profile_ns();
+
+   /* the history was moved about (see sysinfo_resize()): paint it afresh */
+   if (sysinfo.resizes != resizes) {
+      resizes = sysinfo.resizes;
+      graph_invalidate_all();
+      draw_invalidate();
+   }
+
+   first_request = NextRequest(XINFO.disp);
+
+   for (XINFO.bar = XINFO.bars; XINFO.bar != NULL; XINFO.bar = XINFO.bar->next)
+      draw_bar();
+   XINFO.frame_requests = NextRequest(XINFO.disp) - first_request;
+
+   XFlush(XINFO.disp);
+   PROFILE_ADD(profile.flushes, 1);
+   profile_frame(profile_ns() - start, XINFO.frame_requests);
+}
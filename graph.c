@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/param.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+
+#include "graph.h"
+#include "batch.h"
+#include "raster.h"
+#include "span.h"
+
+/* all graphs, so they can be invalidated/freed together */
+static graph_t *graphs = NULL;
+
+/* bumped to force every graph to fully repaint */
+static unsigned int graph_epoch = 1;
+
+void
+graph_init(graph_t *g, XftColor *bg, graph_column_fn column, int arg)
+{
+   g->pixmap = None;
+   g->draw   = NULL;
+   g->cols   = NULL;
+   g->width  = g->height = 0;
+   g->tier   = 0;
+   g->per    = 1;
+   g->drawn  = 0;
+   g->epoch  = 0;
+   g->scale  = 0;
+   g->blit   = false;
+   g->bg     = bg;
+   g->column = column;
+   g->arg    = arg;
+
+   g->next = graphs;
+   graphs = g;
+}
+
+/* (re)create the backing pixmap (or columns) if the graph's size changed */
+static void
+graph_resize(graph_t *g, int width, int height)
+{
+   if (raster_enabled) {
+      if (g->cols != NULL && g->width == width && g->height == height)
+         return;
+
+      free(g->cols);
+      if ((g->cols = calloc(width * height, sizeof(uint32_t))) == NULL)
+         err(1, "graph: columns calloc failed");
+      g->width  = width;
+      g->height = height;
+      g->epoch  = 0;
+      return;
+   }
+
+   if (g->pixmap != None && g->width == width && g->height == height)
+      return;
+
+   if (g->draw != NULL)
+      XftDrawDestroy(g->draw);
+   if (g->pixmap != None)
+      XFreePixmap(XINFO.disp, g->pixmap);
+
+   g->width  = width;
+   g->height = height;
+   g->pixmap = XCreatePixmap(XINFO.disp, RootWindow(XINFO.disp, XINFO.screen),
+                  width, height, XINFO.depth);
+   g->draw   = XftDrawCreate(XINFO.disp, g->pixmap, XINFO.vis,
+                  DefaultColormap(XINFO.disp, XINFO.screen));
+   g->epoch  = 0;
+}
+
+/*
+ * bring the pixmap up to date with the history.  "columns" is the number
+ * of columns begun so far, and the graph is "width" of the newest.
+ */
+void
+graph_update(graph_t *g, unsigned long columns, int width)
+{
+   unsigned long fresh;
+   int col;
+
+   graph_resize(g, width, XINFO.height);
+
+   fresh = columns - g->drawn;
+   if (g->epoch != graph_epoch || fresh >= (unsigned long)g->width) {
+      /* full repaint */
+      fresh = g->width;
+      g->epoch = graph_epoch;
+   } else {
+      /* scroll the old columns left */
+      if (fresh > 0 && raster_enabled)
+         memmove(g->cols, g->cols + fresh * g->height,
+            (g->width - fresh) * g->height * sizeof(uint32_t));
+      else if (fresh > 0)
+         XCopyArea(XINFO.disp, g->pixmap, g->pixmap, XINFO.gc,
+            fresh, 0, g->width - fresh, g->height, 0, 0);
+
+      /* the column that was newest may have grown since */
+      fresh++;
+   }
+
+   for (col = g->width - fresh; col < g->width; col++)
+      g->column(g, col, (long long)columns - (g->width - col));
+
+   g->drawn = columns;
+}
+
+/*
+ * copy the graph into the frame at x.  the new columns are still
+ * sitting in the rectangle batch, so the copy is only queued here and
+ * done by graph_flush() once the batch has been flushed.
+ */
+void
+graph_blit(graph_t *g, int x)
+{
+   g->blit_x = x;
+   g->blit = true;
+}
+
+void
+graph_flush()
+{
+   graph_t *g;
+
+   for (g = graphs; g != NULL; g = g->next) {
+      if (!g->blit)
+         continue;
+
+      if (raster_enabled)
+         raster_columns(g->blit_x, g->cols, g->width, g->height);
+      else
+         XCopyArea(XINFO.disp, g->pixmap, XINFO.bar->frame, XINFO.gc,
+            0, 0, g->width, g->height, g->blit_x, 0);
+      g->blit = false;
+   }
+}
+
+void
+graph_discard()
+{
+   graph_t *g;
+
+   for (g = graphs; g != NULL; g = g->next)
+      g->blit = false;
+}
+
+void
+graph_bar(graph_t *g, int col, int n, const int *h, XftColor **c)
+{
+   uint32_t *p;
+   int i, bar;
+
+   if (!raster_enabled) {
+      batch_bar(g->draw, col, 1, g->height, g->bg, n, h, c);
+      return;
+   }
+
+   /* the bars are painted over each other, bottom up */
+   p = g->cols + col * g->height;
+   span_fill(p, g->height, raster_pixel(g->bg));
+   for (i = 0; i < n; i++) {
+      bar = MIN(h[i], g->height);
+      if (bar > 0)
+         span_fill(p + g->height - bar, bar, raster_pixel(c[i]));
+   }
+}
+
+void
+graph_rect(graph_t *g, int col, int y, int h, XftColor *c)
+{
+   if (raster_enabled)
+      span_fill(g->cols + col * g->height + y, h, raster_pixel(c));
+   else
+      batch_rect(g->draw, c, col, y, 1, h);
+}
+
+void
+graph_invalidate(graph_t *g)
+{
+   g->epoch = 0;
+}
+
+void
+graph_invalidate_all()
+{
+   graph_epoch++;
+}
+
+void
+graph_close_all()
+{
+   graph_t *g;
+
+   for (g = graphs; g != NULL; g = g->next) {
+      if (g->draw != NULL)
+         XftDrawDestroy(g->draw);
+      if (g->pixmap != None)
+         XFreePixmap(XINFO.disp, g->pixmap);
+      free(g->cols);
+      g->draw = NULL;
+      g->pixmap = None;
+      g->cols = NULL;
+   }
+   graphs = NULL;
+}
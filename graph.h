@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "xstatbar.h"
+
+/*
+ * A graph is a scrolling history plot kept in its own offscreen pixmap.
+ * Each column of the pixmap is "per" buckets of one tier of the history
+ * (see hist_t in stats.h), oldest on the left, so a graph's width has
+ * nothing to do with how far back it goes.  When new columns are begun the
+ * pixmap is shifted left with a single XCopyArea and only those, and the
+ * newest (which may have taken in more buckets since), are rasterized; the
+ * result is then copied into the frame by graph_flush().  A full repaint
+ * only happens when the graph's size changes or it has been invalidated
+ * (color change, rescale, another tier).
+ *
+ * When rasterizing client side (see raster.h) the graph is an array of
+ * columns instead, each contiguous, so that scrolling is one memmove and
+ * painting a column is a single span fill.
+ */
+typedef struct graph graph_t;
+
+/*
+ * rasterize one column (x = col) of the graph.  "column" is its number
+ * counting from the first ever, so it covers buckets column * per up to
+ * (column + 1) * per of the tier; it may be before the first.  the whole
+ * column, background included, must be painted, with graph_bar() and
+ * graph_rect().
+ */
+typedef void (*graph_column_fn)(graph_t *g, int col, long long column);
+
+struct graph {
+   Pixmap           pixmap;
+   XftDraw         *draw;
+   uint32_t        *cols;      /* instead of the pixmap, see raster.h */
+   int              width;
+   int              height;
+   int              tier;      /* of the history it draws from */
+   int              per;       /* buckets per column */
+
+   unsigned long    drawn;     /* column count when last rasterized */
+   unsigned int     epoch;     /* graph_epoch when last fully painted */
+   long             scale;     /* widget-defined; a change forces a repaint */
+
+   bool             blit;      /* queued to be copied to the frame */
+   int              blit_x;
+
+   XftColor        *bg;        /* background color of an empty column */
+   graph_column_fn  column;
+   int              arg;       /* widget-defined (e.g. the cpu number) */
+
+   graph_t         *next;      /* list of all graphs */
+};
+
+void graph_init(graph_t *g, XftColor *bg, graph_column_fn column, int arg);
+void graph_update(graph_t *g, unsigned long columns, int width);
+void graph_blit(graph_t *g, int x);
+
+/* paint into a column: as batch_bar() does, or a single rectangle */
+void graph_bar(graph_t *g, int col, int n, const int *h, XftColor **c);
+void graph_rect(graph_t *g, int col, int y, int h, XftColor *c);
+
+void graph_invalidate(graph_t *g);
+void graph_flush();
+void graph_discard();      /* forget the copies queued, unsent */
+
+void graph_invalidate_all();
+void graph_close_all();
+
+#endif
@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <time.h>
+
+#include "stats.h"
+#include "history.h"
+
+char *history_path = NULL;
+
+static history_header_t *header = NULL;
+static size_t            map_size = 0;
+static int               fd = -1;
+
+/* the sample times of the file last closed, for history_sync() */
+static int64_t           closed_time[2][2];
+
+/* the block starts on a cache line, as it does in memory */
+#define HEADER_SIZE ((sizeof(history_header_t) + 63) & ~(size_t)63)
+
+/* milliseconds since the epoch */
+static int64_t
+wall_ms()
+{
+   struct timespec ts;
+
+   if (clock_gettime(CLOCK_REALTIME, &ts) == -1)
+      err(1, "clock_gettime");
+
+   return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void *
+history_open(int hist_size, const history_layout_t *layout, bool *restored)
+{
+   history_header_t h;
+   struct stat st;
+   bool   valid;
+
+   *restored = false;
+   if (history_path == NULL)
+      return NULL;
+
+   if ((fd = open(history_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644)) == -1) {
+      warn("history: %s", history_path);
+      return NULL;
+   }
+   if (flock(fd, LOCK_EX | LOCK_NB) == -1) {
+      warn("history: %s is in use", history_path);
+      close(fd);
+      fd = -1;
+      return NULL;
+   }
+
+   map_size = HEADER_SIZE + layout->bytes;
+   valid = pread(fd, &h, sizeof(h), 0) == sizeof(h)
+        && memcmp(h.magic, HISTORY_MAGIC, sizeof(h.magic)) == 0
+        && h.version     == HISTORY_VERSION
+        && h.header_size == HEADER_SIZE
+        && h.ncpu        == sysinfo.ncpu
+        && h.cpustates   == CPUSTATES
+        && h.hist_size   == hist_size
+        && h.hist_tiers  == HIST_TIERS
+        && memcmp(&h.layout, layout, sizeof(h.layout)) == 0
+        && fstat(fd, &st) == 0 && (size_t)st.st_size == map_size;
+
+   /* start over: truncating and growing it again zeroes everything */
+   if (!valid && (ftruncate(fd, 0) == -1 || ftruncate(fd, map_size) == -1)) {
+      warn("history: %s", history_path);
+      close(fd);
+      fd = -1;
+      return NULL;
+   }
+
+   header = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if (header == MAP_FAILED) {
+      warn("history: mmap %s", history_path);
+      header = NULL;
+      close(fd);
+      fd = -1;
+      return NULL;
+   }
+
+   if (!valid) {
+      memcpy(header->magic, HISTORY_MAGIC, sizeof(header->magic));
+      header->version     = HISTORY_VERSION;
+      header->header_size = HEADER_SIZE;
+      header->ncpu        = sysinfo.ncpu;
+      header->cpustates   = CPUSTATES;
+      header->hist_size   = hist_size;
+      header->hist_tiers  = HIST_TIERS;
+      header->layout      = *layout;
+   }
+
+   *restored = valid;
+   return (char *)header + HEADER_SIZE;
+}
+
+/* copy the cursors into the header */
+static void
+store_cursors()
+{
+   header->current     = sysinfo.current;
+   header->mem_current = sysinfo.mem_current;
+   header->raw_slot    = sysinfo.raw_slot;
+   header->samples     = sysinfo.samples;
+   header->mem_samples = sysinfo.mem_samples;
+}
+
+/*
+ * account for the time the file wasn't written: what was missed shows as
+ * empty samples, in the coarser tiers too (see hist_skip()), however long
+ * that was.  the spacing of samples is taken from the newest two.
+ */
+static void
+fill_gap(int series, int64_t now)
+{
+   int64_t *t = (series == HISTORY_CPU) ? header->cpu_time : header->mem_time;
+   int64_t  spacing = t[0] - t[1];
+   long long missing;
+   int nseries, i, s, *data, *cur;
+   unsigned long *samples;
+   hist_t *h;
+
+   if (t[0] == 0)
+      return;
+
+   if (series == HISTORY_CPU) {
+      nseries = (1 + sysinfo.ncpu) * CPUSTATES;
+      data    = sysinfo.cpu_pcnts;
+      cur     = &sysinfo.current;
+      samples = &sysinfo.samples;
+      h       = &sysinfo.cpu_hist;
+   } else {
+      nseries = 3;
+      data    = sysinfo.memory;
+      cur     = &sysinfo.mem_current;
+      samples = &sysinfo.mem_samples;
+      h       = &sysinfo.mem_hist;
+   }
+
+   /* without a spacing, or with the clock set back, there is no telling */
+   if (spacing <= 0 || now < t[0])
+      return;
+   missing = (now - t[0]) / spacing;
+
+   for (i = 0; i < MIN(missing, sysinfo.hist_size); i++) {
+      for (s = 0; s < nseries; s++)
+         data[s * sysinfo.hist_size + (*cur + 1 + i) % sysinfo.hist_size] = 0;
+   }
+   *cur = (*cur + missing) % sysinfo.hist_size;
+   *samples += missing;
+   h->tiers[0].current = *cur;
+   h->tiers[0].buckets = *samples;
+   hist_skip(h, missing);
+}
+
+/* a tier whose cursor is off the end is started over */
+static void
+check_tiers(hist_t *h)
+{
+   int k;
+
+   for (k = 1; k < HIST_TIERS; k++) {
+      if (h->tiers[k].current < 0 || h->tiers[k].current >= sysinfo.hist_size
+      ||  h->tiers[k].fill < 0 || h->tiers[k].fill > h->tiers[k].factor) {
+         h->tiers[k].current = 0;
+         h->tiers[k].fill    = 0;
+         h->tiers[k].buckets = 0;
+      }
+   }
+}
+
+/* take up the samples of a restored file, once sysinfo points into it */
+void
+history_restore()
+{
+   int64_t now = wall_ms();
+
+   /* a crash while writing a sample leaves it odd */
+   header->seq += header->seq & 1;
+
+   sysinfo.current     = header->current;
+   sysinfo.mem_current = header->mem_current;
+   sysinfo.samples     = header->samples;
+   sysinfo.mem_samples = header->mem_samples;
+   if (sysinfo.current < 0 || sysinfo.current >= sysinfo.hist_size)
+      sysinfo.current = 0;
+   if (sysinfo.mem_current < 0 || sysinfo.mem_current >= sysinfo.hist_size)
+      sysinfo.mem_current = 0;
+   check_tiers(&sysinfo.cpu_hist);
+   check_tiers(&sysinfo.mem_hist);
+
+   /*
+    * the raw ticks are from before the restart (or even a reboot), so the
+    * next cpu sample starts from scratch, as it does at startup
+    */
+   memset(sysinfo.cpu_raw, 0, 2 * sysinfo.ncpu * CPUSTATES * sizeof(uint64_t));
+   sysinfo.raw_slot = 0;
+
+   fill_gap(HISTORY_CPU, now);
+   fill_gap(HISTORY_MEM, now);
+   store_cursors();
+}
+
+bool
+history_mapped()
+{
+   return header != NULL;
+}
+
+void
+history_close()
+{
+   if (header == NULL)
+      return;
+
+   memcpy(closed_time[HISTORY_CPU], header->cpu_time, sizeof(closed_time[0]));
+   memcpy(closed_time[HISTORY_MEM], header->mem_time, sizeof(closed_time[0]));
+   msync(header, map_size, MS_ASYNC);
+   munmap(header, map_size);
+   close(fd);
+   header = NULL;
+   fd = -1;
+}
+
+void
+history_begin()
+{
+   if (header == NULL)
+      return;
+
+   __atomic_store_n(&header->seq, header->seq + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void
+history_end(int series)
+{
+   int64_t *t;
+
+   if (header == NULL)
+      return;
+
+   t = (series == HISTORY_CPU) ? header->cpu_time : header->mem_time;
+   t[1] = t[0];
+   t[0] = wall_ms();
+   store_cursors();
+   __atomic_store_n(&header->seq, header->seq + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * the history was moved into a file started over (it was resized): the
+ * cursors changed outside of a sample, and the times are those of the
+ * file it came from, so a restart still sees how long it was gone
+ */
+void
+history_sync()
+{
+   if (header == NULL)
+      return;
+
+   history_begin();
+   if (header->cpu_time[0] == 0 && header->mem_time[0] == 0) {
+      memcpy(header->cpu_time, closed_time[HISTORY_CPU],
+         sizeof(header->cpu_time));
+      memcpy(header->mem_time, closed_time[HISTORY_MEM],
+         sizeof(header->mem_time));
+   }
+   store_cursors();
+   __atomic_store_n(&header->seq, header->seq + 1, __ATOMIC_RELEASE);
+}
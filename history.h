@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * The history file (-P).  The cpu and memory history are kept in a file
+ * that is mapped and written in place as samples are taken, so that the
+ * graphs pick up where they left off when xstatbar is restarted, and so
+ * that other programs can read them without asking the kernel again.
+ *
+ * The file is a history_header_t followed, at header_size, by the history
+ * block: the series and tiers described in stats.h, at the offsets in the
+ * header's layout.  All of it is in host byte order.  seq is odd while a
+ * sample is being written; a reader should retry if it was odd, or changed
+ * while it was reading.
+ *
+ * A file written for another number of cpus or history size, or by
+ * another version, is started over.  The time it wasn't written is filled
+ * with empty samples (all 0, not idle), so the graphs show the gap.
+ */
+#define HISTORY_MAGIC   "XSBHIST"
+#define HISTORY_VERSION 2
+
+/* where everything is in the history block, in bytes from its start */
+typedef struct {
+   uint64_t  tiers;        /* tier_t [2][HIST_TIERS]: the cpus', memory's */
+   uint64_t  raw;          /* uint64_t [2][ncpu][cpustates] */
+   uint64_t  memory;       /* int [3][hist_size] */
+   uint64_t  cpu;          /* int [1 + ncpu][cpustates][hist_size] */
+   uint64_t  mem_rollup;   /* int [HIST_TIERS - 1][3][3][hist_size] */
+   uint64_t  mem_sums;     /* int64_t [HIST_TIERS - 1][3] */
+   uint64_t  cpu_rollup;   /* int [HIST_TIERS - 1][3][1 + ncpu][cpustates][hist_size] */
+   uint64_t  cpu_sums;     /* int64_t [HIST_TIERS - 1][1 + ncpu][cpustates] */
+   uint64_t  bytes;        /* all of it */
+} history_layout_t;
+
+typedef struct {
+   char      magic[8];
+   uint32_t  version;
+   uint32_t  header_size;    /* where the history block starts */
+   uint32_t  seq;
+   int32_t   ncpu;
+   int32_t   cpustates;
+   int32_t   hist_size;
+   int32_t   hist_tiers;
+   history_layout_t layout;
+
+   /* the cursors, as in sysinfo_t */
+   int32_t   current;
+   int32_t   mem_current;
+   int32_t   raw_slot;
+   int32_t   pad;
+   uint64_t  samples;
+   uint64_t  mem_samples;
+
+   /* when the newest two of each were taken (ms since the epoch) */
+   int64_t   cpu_time[2];
+   int64_t   mem_time[2];
+} history_header_t;
+
+extern char *history_path;    /* NULL for none */
+
+/*
+ * map the history block, laid out as given, from history_path.  returns
+ * NULL (after a warning) if that can't be done, and the history has to be
+ * kept in memory.  *restored is whether it holds samples worth keeping,
+ * in which case history_restore() takes them up once sysinfo points at it.
+ */
+void *history_open(int hist_size, const history_layout_t *layout,
+                   bool *restored);
+void  history_restore();
+bool  history_mapped();
+void  history_close();
+
+/* around writing a sample: keep seq, the cursors and the times up to date */
+#define HISTORY_CPU 0
+#define HISTORY_MEM 1
+void  history_begin();
+void  history_end(int series);
+void  history_sync();
+
+#endif
@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include <sys/param.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+
+#include "widget.h"
+#include "layout.h"
+
+/* as parsed; every bar starts from a copy */
+static slot_t *parsed = NULL;
+static int     nparsed = 0;
+
+/* a number field of a slot, or def if it is empty */
+static int
+slot_field(char **fields, int def, const char *what, const char *slot)
+{
+   const char *errstr, *field;
+   int n;
+
+   if ((field = strsep(fields, ":")) == NULL || *field == '\0')
+      return def;
+
+   n = strtonum(field, 0, INT_MAX, &errstr);
+   if (errstr)
+      errx(1, "illegal %s \"%s\" in layout slot \"%s\": %s", what, field,
+         slot, errstr);
+   return n;
+}
+
+void
+layout_init(const char *desc)
+{
+   char *list, *next, *slot, *fields, *name;
+   bool right, *listed;
+   widget_t *w;
+   int i, part, nparts, priority, min, max;
+
+   if ((list = strdup(desc)) == NULL
+   ||  (listed = calloc(nwidgets, sizeof(bool))) == NULL)
+      err(1, "layout_init: malloc failed");
+
+   right = false;
+   for (next = list; (slot = strsep(&next, " \t,")) != NULL; ) {
+      if (*slot == '\0')
+         continue;
+      if (strcmp(slot, "|") == 0) {
+         if (right)
+            errx(1, "layout \"%s\" has more than one \"|\"", desc);
+         right = true;
+         continue;
+      }
+
+      fields = slot;
+      name = strsep(&fields, ":");
+      if ((w = widget_find(name)) == NULL)
+         errx(1, "unknown widget \"%s\" in layout", name);
+      i = w - widgets;
+      if (listed[i])
+         errx(1, "widget \"%s\" is in the layout twice", name);
+      listed[i] = true;
+
+      priority = slot_field(&fields, 0, "priority", name);
+      min      = slot_field(&fields, 0, "minimum width", name);
+      max      = slot_field(&fields, 0, "maximum width", name);
+      if (fields != NULL)
+         errx(1, "too many fields in layout slot \"%s\"", name);
+
+      /* nothing to draw, or not drawn at all */
+      if (!w->enabled || w->draw == NULL)
+         continue;
+
+      nparts = widget_nparts(w);
+      parsed = reallocarray(parsed, nparsed + nparts, sizeof(slot_t));
+      if (parsed == NULL)
+         err(1, "layout_init: realloc failed");
+      for (part = 0; part < nparts; part++) {
+         parsed[nparsed].widget   = i;
+         parsed[nparsed].part     = part;
+         parsed[nparsed].priority = priority;
+         parsed[nparsed].min      = min;
+         parsed[nparsed].max      = max;
+         parsed[nparsed].right    = right;
+         parsed[nparsed].width[FORM_FULL]    = -1;
+         parsed[nparsed].width[FORM_COMPACT] = -1;
+         parsed[nparsed].form     = FORM_FULL;
+         parsed[nparsed].x        = 0;
+         nparsed++;
+      }
+   }
+
+   free(listed);
+   free(list);
+}
+
+layout_t *
+layout_new()
+{
+   layout_t *l;
+
+   if ((l = calloc(1, sizeof(layout_t))) == NULL
+   ||  (l->slots = calloc(MAX(nparsed, 1), sizeof(slot_t))) == NULL)
+      err(1, "layout_new: calloc failed");
+   memcpy(l->slots, parsed, nparsed * sizeof(slot_t));
+   l->nslots = nparsed;
+   l->width = -1;
+   return l;
+}
+
+void
+layout_free(layout_t *l)
+{
+   free(l->slots);
+   free(l);
+}
+
+/* the width a form of a slot takes, as far as is known */
+static int
+form_width(const slot_t *s, int form)
+{
+   return MAX(s->width[form], s->min);
+}
+
+/* the width a slot takes as it is */
+static int
+slot_width(const slot_t *s)
+{
+   if (s->form == FORM_HIDDEN)
+      return 0;
+   return form_width(s, s->form);
+}
+
+/* the width all slots take, with the spacing between those that show */
+static int
+layout_span(const layout_t *l)
+{
+   int i, w, n, span;
+
+   span = n = 0;
+   for (i = 0; i < l->nslots; i++) {
+      if ((w = slot_width(&l->slots[i])) > 0) {
+         span += w;
+         n++;
+      }
+   }
+
+   return n > 0 ? span + (n - 1) * LAYOUT_SPACING : 0;
+}
+
+/*
+ * the slot to give way next: of the lowest priority, one that can still
+ * collapse before one that can only be dropped, and the last of those
+ */
+static slot_t *
+layout_victim(layout_t *l)
+{
+   slot_t *s, *victim;
+   int i, rank, best;
+
+   victim = NULL;
+   best = 0;
+   for (i = 0; i < l->nslots; i++) {
+      s = &l->slots[i];
+      if (s->form == FORM_HIDDEN || slot_width(s) == 0)
+         continue;
+
+      /* a compact form never drawn might be narrower, so is tried */
+      rank = s->priority * 2;
+      if (s->form == FORM_COMPACT
+      ||  form_width(s, FORM_COMPACT) >= slot_width(s))
+         rank++;
+
+      if (victim == NULL || rank <= best) {
+         victim = s;
+         best = rank;
+      }
+   }
+
+   return victim;
+}
+
+void
+layout_compute(layout_t *l, int width)
+{
+   slot_t *s;
+   int i, x;
+
+   /* everything in full, unless over its budget */
+   for (i = 0; i < l->nslots; i++) {
+      s = &l->slots[i];
+      s->form = FORM_FULL;
+      if (s->max > 0 && s->width[FORM_FULL] > s->max)
+         s->form = s->width[FORM_COMPACT] > s->max ? FORM_HIDDEN : FORM_COMPACT;
+   }
+
+   /* then give way until it all fits */
+   while (layout_span(l) > width && (s = layout_victim(l)) != NULL) {
+      if (s->form == FORM_FULL && form_width(s, FORM_COMPACT) < slot_width(s))
+         s->form = FORM_COMPACT;
+      else
+         s->form = FORM_HIDDEN;
+   }
+
+   /* the left slots from the left edge, the right ones up to the right */
+   x = 0;
+   for (i = 0; i < l->nslots; i++) {
+      s = &l->slots[i];
+      if (s->right || s->form == FORM_HIDDEN)
+         continue;
+      s->x = x;
+      if (slot_width(s) > 0)
+         x += slot_width(s) + LAYOUT_SPACING;
+   }
+   x = width;
+   for (i = l->nslots - 1; i >= 0; i--) {
+      s = &l->slots[i];
+      if (!s->right || s->form == FORM_HIDDEN)
+         continue;
+      x -= slot_width(s);
+      s->x = x;
+      if (slot_width(s) > 0)
+         x -= LAYOUT_SPACING;
+   }
+
+   l->width = width;
+   l->dirty = false;
+}
+
+/*
+ * the layout only goes by the width with the minimum filled in, and by
+ * whether it is over the budget, so a slot that changed within those
+ * (a clock in a wide enough slot, say) leaves everything where it is
+ */
+bool
+layout_fit(layout_t *l, slot_t *s, int width)
+{
+   int was;
+
+   if (s->form == FORM_HIDDEN)
+      return l->dirty;
+
+   was = s->width[s->form];
+   s->width[s->form] = width;
+   if (MAX(was, s->min) != MAX(width, s->min)
+   ||  (s->max > 0 && (was > s->max) != (width > s->max)))
+      l->dirty = true;
+
+   return l->dirty;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stdbool.h>
+
+/*
+ * The layout of a bar: where each part of each widget goes.  It is
+ * described (-l, or the "layout" resource) as a list of slots
+ *
+ *    widget[:priority[:min[:max]]] ...  |  widget[...] ...
+ *
+ * separated by spaces or commas, those after the "|" aligned to the right
+ * edge.  That is parsed once, by layout_init(), into a flat list with a
+ * slot for every part of every widget listed; each bar gets a copy.
+ *
+ * A slot is at least min pixels wide.  A widget wider than max (0 for no
+ * limit) is drawn in its compact form instead, or not at all if that is
+ * too wide still.  When the bar is too narrow for all of them, the slots
+ * of the lowest priority give way first: they collapse to their compact
+ * form, then they are dropped, the last first.
+ *
+ * The widths of the slots are only known once drawn; they are kept, and
+ * the bar is laid out again only when one of them changed past its min
+ * or its max (see layout_fit()), or the bar was resized.
+ */
+#define LAYOUT_SPACING 10   /* pixels between slots */
+
+#define FORM_FULL    0
+#define FORM_COMPACT 1
+#define FORM_HIDDEN  2
+
+typedef struct {
+   int   widget;        /* index into widgets[] */
+   int   part;
+   int   priority;      /* the higher, the longer it stays */
+   int   min, max;      /* width budget, in pixels; max 0 for none */
+   bool  right;         /* after the "|" */
+
+   int   width[2];      /* of each form as last drawn, -1 if never */
+   int   form;          /* FORM_* */
+   int   x;
+} slot_t;
+
+typedef struct layout {
+   slot_t  *slots;
+   int      nslots;
+   int      width;      /* of the bar it is laid out for */
+   bool     dirty;      /* a slot's width changed since */
+} layout_t;
+
+/* what the layout is without -l or the resource */
+#define LAYOUT_DEFAULT "cpu:1 mem:2 procs:1 power:3 volume:2 | time:4"
+
+/* parse the layout; errx()s on a bad one.  the widgets must be sampled */
+void       layout_init(const char *desc);
+
+/* a copy of it, for a bar, and freeing that */
+layout_t  *layout_new();
+void       layout_free(layout_t *l);
+
+/* lay the slots out on a bar width pixels wide */
+void       layout_compute(layout_t *l, int width);
+
+/* slot s was drawn width pixels wide; true if the layout has to change */
+bool       layout_fit(layout_t *l, slot_t *s, int width);
+
+#endif
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <err.h>
+
+#include "stats.h"
+#include "widget.h"
+#include "profile.h"
+
+profile_t profile;
+
+static long long   recent[PROFILE_RECENT];   /* ring of frame times */
+static long long   start_ns;
+static const char *dump_path = NULL;         /* NULL for stderr */
+static bool        dump_at_exit = false;
+
+void
+profile_init()
+{
+   const char *env;
+
+   memset(&profile, 0, sizeof(profile));
+   start_ns = profile_ns();
+
+   if ((env = getenv("XSTATBAR_PROFILE")) != NULL) {
+      dump_at_exit = true;
+      if (*env != '\0' && strcmp(env, "-") != 0)
+         dump_path = env;
+   }
+}
+
+/* nanoseconds on the monotonic clock */
+long long
+profile_ns()
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* a frame took ns nanoseconds and that many X requests (main thread only) */
+void
+profile_frame(long long ns, unsigned long requests)
+{
+   recent[profile.frames % PROFILE_RECENT] = ns;
+   PROFILE_ADD(profile.frames, 1);
+   PROFILE_ADD(profile.requests, requests);
+   PROFILE_ADD(profile.frame_ns, ns);
+   if (ns > profile.frame_max_ns)
+      profile.frame_max_ns = ns;
+}
+
+static int
+cmp_ll(const void *a, const void *b)
+{
+   long long x = *(const long long *)a, y = *(const long long *)b;
+
+   return (x > y) - (x < y);
+}
+
+/* per-something averages, without dividing by zero */
+static double
+per(double x, unsigned long n)
+{
+   return n == 0 ? 0 : x / n;
+}
+
+void
+profile_dump()
+{
+   static long long sorted[PROFILE_RECENT];
+   FILE  *f = stderr;
+   widget_t *w;
+   unsigned long frames, ticks, updates;
+   long long p99 = 0;
+   int   n, i;
+
+   if (dump_path != NULL && (f = fopen(dump_path, "a")) == NULL) {
+      warn("profile: %s", dump_path);
+      return;
+   }
+
+   frames = PROFILE_GET(profile.frames);
+   ticks  = PROFILE_GET(profile.ticks);
+   n = frames < PROFILE_RECENT ? frames : PROFILE_RECENT;
+   if (n > 0) {
+      memcpy(sorted, recent, n * sizeof(long long));
+      qsort(sorted, n, sizeof(long long), cmp_ll);
+      p99 = sorted[(99 * n + 99) / 100 - 1];
+   }
+
+   fprintf(f, "xstatbar profile, after %.0f s:\n",
+      (profile_ns() - start_ns) / 1e9);
+   fprintf(f, "frames     %lu, %.3f ms mean, %.3f ms max, "
+      "%.3f ms p99 of the last %d\n", frames,
+      per(PROFILE_GET(profile.frame_ns) / 1e6, frames),
+      profile.frame_max_ns / 1e6, p99 / 1e6, n);
+   fprintf(f, "x          %.1f requests, %.1f flushes per frame\n",
+      per(PROFILE_GET(profile.requests), frames),
+      per(PROFILE_GET(profile.flushes), frames));
+   fprintf(f, "sampler    %lu runs, %.1f system calls per run, "
+      "%lu snapshots\n", ticks, per(PROFILE_GET(stat_syscalls), ticks),
+      PROFILE_GET(profile.publishes));
+   fprintf(f, "batch      %lu rectangles in %lu fills\n",
+      PROFILE_GET(profile.rects), PROFILE_GET(profile.fills));
+   fprintf(f, "text       %lu glyph cache hits, %lu misses\n",
+      PROFILE_GET(profile.glyph_hits), PROFILE_GET(profile.glyph_misses));
+
+   fprintf(f, "%-10s %10s %10s %10s %10s\n",
+      "widget", "updates", "us/update", "draws", "us/draw");
+   for (i = 0; i < nwidgets; i++) {
+      w = &widgets[i];
+      if (!w->enabled)
+         continue;
+      updates = PROFILE_GET(w->updates);
+      fprintf(f, "%-10s %10lu %10.1f %10lu %10.1f\n", w->name,
+         updates, per(PROFILE_GET(w->update_ns) / 1e3, updates),
+         PROFILE_GET(w->draws),
+         per(PROFILE_GET(w->draw_ns) / 1e3, PROFILE_GET(w->draws)));
+   }
+
+   if (f == stderr)
+      fflush(f);
+   else
+      fclose(f);
+}
+
+/* called at exit: dump, if asked to by XSTATBAR_PROFILE */
+void
+profile_exit()
+{
+   if (dump_at_exit)
+      profile_dump();
+}
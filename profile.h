@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+
+/*
+ * Self-profiling.  xstatbar keeps a few counters about what it costs
+ * itself: these and the cost of each widget (see widget.h) are printed by
+ * profile_dump(), on SIGUSR1.  They go to stderr, or are appended to the
+ * file named by XSTATBAR_PROFILE, if set; then they are also dumped at
+ * exit.
+ *
+ * Keeping them costs a couple of clock_gettime(2)s per frame and widget;
+ * nothing is formatted unless asked for.
+ *
+ * The sampler thread counts too (its runs, system calls and widget
+ * updates) while the main thread dumps, so the counters are only added to
+ * with PROFILE_ADD() and read with PROFILE_GET(): relaxed atomics, which
+ * order nothing but don't tear or lose counts.  The frame times are only
+ * ever touched by the main thread.
+ */
+#define PROFILE_ADD(counter, n) \
+   __atomic_fetch_add(&(counter), (n), __ATOMIC_RELAXED)
+#define PROFILE_GET(counter) \
+   __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+
+typedef struct {
+   unsigned long  frames;         /* draw()s */
+   unsigned long  requests;       /* X requests sent by them */
+   unsigned long  flushes;        /* XFlush()es */
+   long long      frame_ns;       /* time spent in draw() */
+   long long      frame_max_ns;
+
+   unsigned long  ticks;          /* sampler runs, see sampler.c */
+   unsigned long  publishes;      /* and the snapshots they published */
+
+   /* how much the batching saves (see batch.h) */
+   unsigned long  rects;          /* rectangles pushed */
+   unsigned long  fills;          /* fill requests sent */
+
+   /* the text cache's hit rate (see text.h): strings measured from the
+    * cache alone, and glyphs that had to be measured through Xft */
+   unsigned long  glyph_hits;
+   unsigned long  glyph_misses;
+} profile_t;
+extern profile_t profile;
+
+/* the latency percentiles are over this many of the latest frames */
+#define PROFILE_RECENT 1024
+
+void      profile_init();
+long long profile_ns();
+void      profile_frame(long long ns, unsigned long requests);
+void      profile_dump();
+void      profile_exit();
+
+#endif
@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+
+#include <X11/Xlib.h>
+#include <X11/extensions/XShm.h>
+
+#include "raster.h"
+#include "span.h"
+
+bool raster_enabled = false;
+
+/*
+ * the frame, as an image backed by a 32 bit pixmap that is composited
+ * over the frame of the bar being drawn.  it is as wide as the widest bar
+ * and used by each in turn.  px is the image's data: shared memory if shm
+ * is set.
+ */
+static Visual          *argb_vis = NULL;
+static XImage          *image = NULL;
+static XShmSegmentInfo  shminfo;
+static bool             shm = false;
+static Pixmap           pixmap = None;
+static Picture          picture = None;
+static GC               gc = None;
+static uint32_t        *px = NULL;
+static int              width = 0, height = 0;
+
+/*
+ * the columns painted this frame, [dirty_x0, dirty_x1), and those of the
+ * last upload that still have to be made transparent again.  with shm
+ * that has to wait until the server is done reading them.
+ */
+static int dirty_x0, dirty_x1;
+static int stale_x0, stale_x1;
+
+/* set by the error handler while trying to attach the shared memory */
+static bool shm_failed;
+
+static int
+shm_error(Display *d, XErrorEvent *e)
+{
+   shm_failed = true;
+   return 0;
+}
+
+bool
+raster_init()
+{
+   XVisualInfo vi;
+
+   if (!XMatchVisualInfo(XINFO.disp, XINFO.screen, 32, TrueColor, &vi)
+   ||  XRenderFindStandardFormat(XINFO.disp, PictStandardARGB32) == NULL) {
+      warnx("no 32 bit visual, not rasterizing client side");
+      raster_enabled = false;
+      return false;
+   }
+
+   argb_vis = vi.visual;
+   shm = XShmQueryExtension(XINFO.disp);
+   return true;
+}
+
+/* put the image in shared memory.  false if the server can't get at it */
+static bool
+shm_create()
+{
+   int (*handler)(Display *, XErrorEvent *);
+
+   image = XShmCreateImage(XINFO.disp, argb_vis, 32, ZPixmap, NULL, &shminfo,
+      width, height);
+   if (image == NULL)
+      return false;
+
+   shminfo.shmid = shmget(IPC_PRIVATE, image->bytes_per_line * height,
+      IPC_CREAT | 0600);
+   if (shminfo.shmid == -1) {
+      XDestroyImage(image);
+      return false;
+   }
+   shminfo.shmaddr = image->data = shmat(shminfo.shmid, NULL, 0);
+   shminfo.readOnly = False;
+
+   /* a remote server fails the attach, which only shows as an error */
+   shm_failed = (shminfo.shmaddr == (char *)-1);
+   if (!shm_failed) {
+      handler = XSetErrorHandler(shm_error);
+      XShmAttach(XINFO.disp, &shminfo);
+      XSync(XINFO.disp, False);
+      XSetErrorHandler(handler);
+   }
+
+   /* either way, it goes away with the last detach */
+   shmctl(shminfo.shmid, IPC_RMID, NULL);
+   if (shm_failed) {
+      if (shminfo.shmaddr != (char *)-1)
+         shmdt(shminfo.shmaddr);
+      image->data = NULL;
+      XDestroyImage(image);
+      image = NULL;
+      return false;
+   }
+
+   return true;
+}
+
+static void
+image_create()
+{
+   static const int one = 1;
+   char *data;
+
+   if (shm && shm_create())
+      return;
+   shm = false;
+
+   if ((data = calloc(height, width * sizeof(uint32_t))) == NULL)
+      err(1, "raster: image calloc failed");
+   image = XCreateImage(XINFO.disp, argb_vis, 32, ZPixmap, 0, data,
+      width, height, 32, width * sizeof(uint32_t));
+   if (image == NULL)
+      errx(1, "raster: XCreateImage failed");
+
+   /* the pixels are written as host words; Xlib swaps them if needed */
+   image->byte_order = (*(const char *)&one == 1) ? LSBFirst : MSBFirst;
+}
+
+static void
+image_destroy()
+{
+   if (image == NULL)
+      return;
+
+   if (shm) {
+      XShmDetach(XINFO.disp, &shminfo);
+      XSync(XINFO.disp, False);
+      XDestroyImage(image);
+      shmdt(shminfo.shmaddr);
+   } else
+      XDestroyImage(image);
+   image = NULL;
+   px = NULL;
+}
+
+/* (re)create the frames' buffer, all transparent, at the widest's size */
+void
+raster_resize(int w, int h)
+{
+   XRenderPictFormat *fmt;
+
+   if (!raster_enabled)
+      return;
+
+   raster_close();
+   width  = w;
+   height = h;
+
+   image_create();
+   px = (uint32_t *)image->data;
+   memset(px, 0, image->bytes_per_line * height);
+
+   fmt = XRenderFindStandardFormat(XINFO.disp, PictStandardARGB32);
+   pixmap  = XCreatePixmap(XINFO.disp, RootWindow(XINFO.disp, XINFO.screen),
+                width, height, 32);
+   picture = XRenderCreatePicture(XINFO.disp, pixmap, fmt, 0, NULL);
+   gc      = XCreateGC(XINFO.disp, pixmap, 0, NULL);
+
+   dirty_x0 = stale_x0 = width;
+   dirty_x1 = stale_x1 = 0;
+}
+
+void
+raster_close()
+{
+   image_destroy();
+   if (picture != None)
+      XRenderFreePicture(XINFO.disp, picture);
+   if (pixmap != None)
+      XFreePixmap(XINFO.disp, pixmap);
+   if (gc != None)
+      XFreeGC(XINFO.disp, gc);
+   picture = None;
+   pixmap = None;
+   gc = None;
+}
+
+uint32_t
+raster_pixel(const XftColor *c)
+{
+   return (uint32_t)(c->color.alpha >> 8) << 24
+        | (uint32_t)(c->color.red   >> 8) << 16
+        | (uint32_t)(c->color.green >> 8) << 8
+        | (uint32_t)(c->color.blue  >> 8);
+}
+
+/* about to paint columns [x0, x1): first wipe what the last upload left */
+static void
+raster_touch(int x0, int x1)
+{
+   int y;
+
+   if (stale_x0 < stale_x1) {
+      if (shm)
+         XSync(XINFO.disp, False);
+      for (y = 0; y < height; y++)
+         memset(px + y * width + stale_x0, 0,
+            (stale_x1 - stale_x0) * sizeof(uint32_t));
+      stale_x0 = width;
+      stale_x1 = 0;
+   }
+
+   dirty_x0 = MIN(dirty_x0, x0);
+   dirty_x1 = MAX(dirty_x1, x1);
+}
+
+void
+raster_rect(int x, int y, int w, int h, const XftColor *c)
+{
+   uint32_t pixel = raster_pixel(c);
+
+   /* clip to the frame */
+   if (x < 0) {
+      w += x;
+      x = 0;
+   }
+   if (y < 0) {
+      h += y;
+      y = 0;
+   }
+   w = MIN(w, width - x);
+   h = MIN(h, height - y);
+   if (w <= 0 || h <= 0)
+      return;
+
+   raster_touch(x, x + w);
+   for (; h > 0; h--, y++)
+      span_fill(px + y * width + x, w, pixel);
+}
+
+/* the columns are stored one after the other, each top down */
+void
+raster_columns(int x, const uint32_t *cols, int ncols, int h)
+{
+   int col, y;
+
+   ncols = MIN(ncols, width - x);
+   h = MIN(h, height);
+   if (x < 0 || ncols <= 0)
+      return;
+
+   raster_touch(x, x + ncols);
+   for (col = 0; col < ncols; col++, cols += h) {
+      for (y = 0; y < h; y++)
+         px[y * width + x + col] = cols[y];
+   }
+}
+
+void
+raster_discard()
+{
+   int y;
+
+   if (!raster_enabled || dirty_x0 >= dirty_x1)
+      return;
+
+   /* not uploaded yet, so the server isn't reading it */
+   for (y = 0; y < height; y++)
+      memset(px + y * width + dirty_x0, 0,
+         (dirty_x1 - dirty_x0) * sizeof(uint32_t));
+   dirty_x0 = width;
+   dirty_x1 = 0;
+}
+
+void
+raster_flush()
+{
+   int w;
+
+   if (!raster_enabled || dirty_x0 >= dirty_x1)
+      return;
+
+   w = dirty_x1 - dirty_x0;
+   if (shm)
+      XShmPutImage(XINFO.disp, pixmap, gc, image, dirty_x0, 0, dirty_x0, 0,
+         w, height, False);
+   else
+      XPutImage(XINFO.disp, pixmap, gc, image, dirty_x0, 0, dirty_x0, 0,
+         w, height);
+
+   XRenderComposite(XINFO.disp, PictOpOver, picture, None,
+      XftDrawPicture(XINFO.bar->xftdraw), dirty_x0, 0, 0, 0, dirty_x0, 0,
+      w, height);
+
+   stale_x0 = dirty_x0;
+   stale_x1 = dirty_x1;
+   dirty_x0 = width;
+   dirty_x1 = 0;
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "xstatbar.h"
+
+/*
+ * Client-side rasterizing (-R).  Rather than sending the graphs and
+ * meters to the server as rectangles, they are filled into an ARGB buffer
+ * the size of the frame, which is uploaded once a frame (with MIT-SHM if
+ * the server is local, else XPutImage) and composited over the frame.
+ * Pixels not painted in a frame are left transparent, so the text, which
+ * still goes through Xft, and whatever wasn't redrawn show through.
+ *
+ * The graphs keep their own columns (see graph.h), which raster_columns()
+ * copies into the frame.
+ */
+
+extern bool raster_enabled;
+
+/* whether the server can take it; if not, raster_enabled is cleared */
+bool     raster_init();
+void     raster_resize(int width, int height);
+void     raster_close();
+
+/* the premultiplied ARGB of a color */
+uint32_t raster_pixel(const XftColor *c);
+
+/* paint into the frame: a rectangle, or ncols columns of height pixels each */
+void     raster_rect(int x, int y, int w, int h, const XftColor *c);
+void     raster_columns(int x, const uint32_t *cols, int ncols, int height);
+
+/* upload and composite what was painted, at the end of a frame */
+void     raster_flush();
+
+/* make what was painted since the last flush transparent again, unsent */
+void     raster_discard();
+
+#endif
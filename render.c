@@ -0,0 +1,586 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *  misc updates by   Dmitrij D. Czarkoff <czarkoff@gmail.cim>
+ *  cpu consolidation Martin Brandenburg <martin@martinbrandenburg.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "stats.h"
+#include "widget.h"
+#include "render.h"
+
+/*
+ * Drawing the stats collected by stats.c onto the bar: everything of
+ * them that needs X.
+ */
+
+/* draw text in a given color at a given (x,y) */
+static int
+render_text(XftColor *c, int x, int y, const char *str)
+{
+   XftDrawString8(XINFO.bar->xftdraw, c, XINFO.font, x, y, (XftChar8 *)str, strlen(str));
+   return text_width(str);
+}
+
+
+/*****************************************************************************
+ * volume stuff
+ ****************************************************************************/
+
+int
+volume_draw(XftColor *color, int x, int y, bool compact)
+{
+   static char str[6];
+   static XftColor *fg = &COLOR2;
+   float left, right;
+   int   lheight, rheight;
+   int   startx;
+   int   width = 5;  /* width of the bar-graphs */
+
+   if (!volume.is_setup)
+      return 0;
+
+   startx = x;
+   width = 5;
+
+   /* get volume as percents */
+   left  = roundf(100.0 * (float)volume.left  / (float)volume.max);
+   right = roundf(100.0 * (float)volume.right / (float)volume.max);
+
+   /* determine height of green-part of bar graphs */
+   lheight = (int)(left  * (float)XINFO.height / 100.0);
+   rheight = (int)(right * (float)XINFO.height / 100.0);
+
+   /* start drawing... */
+   x += render_text(color, x, y, "vol:");
+
+   if (volume.muted) {
+      x += render_text(&COLOR1, x, y, "mute");
+      return x - startx;
+   }
+
+   /* left volume % */
+   if (!compact) {
+      snprintf(str, sizeof(str), "%d%%", (int)left);
+      x += render_text(color, x, y, str) + 1;
+   }
+
+   /* left graph */
+   batch_bar(XINFO.bar->xftdraw, x, width, XINFO.height, &COLOR1, 1, &lheight, &fg);
+   x += width + 1;
+
+   /* right graph */
+   batch_bar(XINFO.bar->xftdraw, x, width, XINFO.height, &COLOR1, 1, &rheight, &fg);
+   x += width + 1;
+
+   /* right volume % */
+   if (!compact) {
+      snprintf(str, sizeof(str), "%d%%", (int)right);
+      x += render_text(color, x, y, str);
+   }
+
+   return x - startx;
+}
+
+
+/*****************************************************************************
+ * power stuff
+ ****************************************************************************/
+
+int
+power_draw(XftColor *color, int x, int y, bool compact)
+{
+   static char str[1000];
+   static XftColor *fg = &COLOR2;
+   char *state;
+   int startx, width, h;
+
+   if (!power.is_setup)
+      return 0;
+
+   startx = x;
+   width = 5;
+
+   switch (power.ac_state) {
+      case AC_OFF:
+         state = "BAT";
+         break;
+      case AC_ON:
+         state = "AC";
+         break;
+      default:
+         return 0;
+         break;
+   }
+
+   /* draw the state */
+   snprintf(str, sizeof(str), "%s:", state);
+   x += render_text(color, x, y, str) + 1;
+
+   /* draw the graph */
+   h = power.battery_life * XINFO.height / 100;
+   batch_bar(XINFO.bar->xftdraw, x, width, XINFO.height, &COLOR1, 1, &h, &fg);
+
+   x += width + 1;
+   if (compact)
+      return x - startx;
+
+   /* draw the percent and, when draining, the time remaining */
+   if (power.ac_state == AC_OFF && power.minutes_left >= 0)
+      snprintf(str, sizeof(str), "(%d%%,%dm)", power.battery_life,
+         power.minutes_left);
+   else
+      snprintf(str, sizeof(str), "(%d%%)", power.battery_life);
+
+   x += render_text(color, x, y, str);
+   return x - startx;
+}
+
+
+/*****************************************************************************
+ * sysinf stuff (cpu/mem/procs)
+ ****************************************************************************/
+
+/*
+ * point graph g, "width" columns wide, at the tier of the history that
+ * goes back "window" samples (0 for one per column): the finest that goes
+ * back that far, or else the coarsest, merging as many buckets per column
+ * as that takes.  returns the number of columns begun so far.
+ */
+static unsigned long
+hist_view(graph_t *g, const hist_t *h, int window, int width)
+{
+   static const int factors[] = HIST_FACTORS;
+   const tier_t *t;
+   int k, need, per;
+
+   if (window <= 0)
+      window = width;
+
+   for (k = 0; k < HIST_TIERS - 1; k++) {
+      if ((long long)sysinfo.hist_size * factors[k] >= window)
+         break;
+   }
+   need = (window + factors[k] - 1) / factors[k];
+   per  = MAX(1, (need + width - 1) / width);
+
+   if (g->tier != k || g->per != per) {
+      g->tier = k;
+      g->per  = per;
+      graph_invalidate(g);
+   }
+
+   t = &h->tiers[k];
+   return t->buckets == 0 ? 0 : (t->buckets - 1) / per + 1;
+}
+
+/*
+ * merge the buckets of series s that a column of g covers: the lowest
+ * min, the highest max and the mean of the means.  false if none of them
+ * are in the history, yet or any more.
+ */
+static bool
+hist_column(const graph_t *g, const hist_t *h, int s, long long column,
+            int *min, int *max, int *mean)
+{
+   const tier_t *t = &h->tiers[g->tier];
+   long long newest, first, last, b, sum;
+   int *mins, *maxs, *means, i, n;
+
+   newest = (long long)t->buckets - 1;
+   first  = MAX(column * g->per, newest - sysinfo.hist_size + 1);
+   last   = MIN(column * g->per + g->per - 1, newest);
+   if (column < 0 || first > last)
+      return false;
+
+   mins  = hist_series(h, g->tier, TIER_MIN,  s);
+   maxs  = hist_series(h, g->tier, TIER_MAX,  s);
+   means = hist_series(h, g->tier, TIER_MEAN, s);
+
+   *min = INT_MAX;
+   *max = INT_MIN;
+   sum = n = 0;
+   for (b = first; b <= last; b++, n++) {
+      i = (t->current - (int)(newest - b) + sysinfo.hist_size)
+        % sysinfo.hist_size;
+      *min = MIN(*min, mins[i]);
+      *max = MAX(*max, maxs[i]);
+      sum += means[i];
+   }
+   *mean = sum / n;
+   return true;
+}
+
+/*
+ * how busy cpu (-1 for all) was at its busiest in a column of g.  not
+ * 100 - idle: a sample that is all 0 (a gap in the history, or a cpu that
+ * was offline) wasn't busy.  so it is the least of that and the sum of
+ * the other states' maxima, which are both at least the busiest sample,
+ * and exact unless a column mixes such samples with others.
+ */
+static bool
+cpu_busiest(const graph_t *g, int cpu, long long column, int *busy)
+{
+   int series = (cpu + 1) * CPUSTATES;
+   int min, max, mean, state, sum;
+
+   if (!hist_column(g, &sysinfo.cpu_hist, series + CP_IDLE, column,
+         &min, &max, &mean))
+      return false;
+   *busy = 100 - min;
+
+   sum = 0;
+   for (state = 0; state < CPUSTATES; state++) {
+      if (state != CP_IDLE && hist_column(g, &sysinfo.cpu_hist,
+            series + state, column, &min, &max, &mean))
+         sum += max;
+   }
+   *busy = MIN(*busy, sum);
+   return true;
+}
+
+/* whether a graph's columns are each more than one sample */
+#define DECIMATED(g) ((g)->tier > 0 || (g)->per > 1)
+
+/* one column of a cpu graph; g->arg is the cpu, or -1 for all of them */
+static void
+cpu_column(graph_t *g, int col, long long column)
+{
+   static XftColor *colors[] = {
+      &COLOR6, &COLOR1, &COLOR4, &COLOR3, &COLOR5
+   };
+   int bars[5] = { 0, 0, 0, 0, 0 };
+   int series = (g->arg + 1) * CPUSTATES;
+   int min, max, mean, busy;
+   int h, i;
+
+   /*
+    * the bars are stacked: user time on top of nice, on top of system, on
+    * top of interrupt time.  so each bar is its state and all below it.
+    */
+   h = 0;
+   for (i = 3; i >= 0; i--) {
+      if (!hist_column(g, &sysinfo.cpu_hist, series + i, column,
+            &min, &max, &mean))
+         break;
+      h += mean;
+      bars[i + 1] = h * g->height / 100;
+   }
+
+   /* behind them, when a column is many samples, how busy the busiest was */
+   if (DECIMATED(g) && cpu_busiest(g, g->arg, column, &busy))
+      bars[0] = busy * g->height / 100;
+
+   graph_bar(g, col, 5, bars, colors);
+}
+
+/* the percentages of each state of a cpu (or all, for -1) */
+static int
+cpu_text(int cpu, int x, int y)
+{
+   static char  str[1000];
+   static char *cpuStateNames[] = { "u", "n", "s", "i", "I" };
+   static XftColor *cpuStateColors[] = {
+     &COLOR1, &COLOR4, &COLOR3, &COLOR5, &COLOR2
+   };
+   int state, startx;
+
+   startx = x;
+   for (state = 0; state < CPUSTATES; state++) {
+      snprintf(str, sizeof(str), "%3d%%%s",
+         CPU_HIST(cpu, state)[sysinfo.current], cpuStateNames[state]);
+      x += render_text(cpuStateColors[state], x, y, str);
+   }
+
+   return x - startx;
+}
+
+int
+cpu_draw(int cpu, XftColor *color, int x, int y, bool compact)
+{
+   static char  str[1000];
+   static graph_t *graphs = NULL;   /* [ncpu + 1], the first is "all" */
+   graph_t *g;
+   int startx, i;
+
+   startx = x;
+
+   if (graphs == NULL) {
+      if ((graphs = calloc(sysinfo.ncpu + 1, sizeof(graph_t))) == NULL)
+         err(1, "cpu draw: graphs calloc failed");
+      for (i = 0; i <= sysinfo.ncpu; i++)
+         graph_init(&graphs[i], &COLOR2, cpu_column, i - 1);
+   }
+
+   if (cpu == -1)
+      snprintf(str, sizeof(str), "cpu: ");
+   else
+      snprintf(str, sizeof(str), "cpu%d: ", cpu);
+   x += render_text(color, x, y, str) + 1;
+
+   /* the graph only needs the new samples drawn into it */
+   g = &graphs[cpu + 1];
+   graph_update(g, hist_view(g, &sysinfo.cpu_hist, cpu_window, graph_width),
+      graph_width);
+   graph_blit(g, x);
+   x += g->width + 1;
+
+   /* draw the text */
+   if (!compact)
+      x += cpu_text(cpu, x, y);
+
+   return x - startx;
+}
+
+/*
+ * the cpu heatmap: every cpu is a band of rows (or, with more cpus than
+ * rows, every row a band of cpus) colored by how busy it was, from the
+ * idle color through COLOR3 to COLOR1.  it's a single graph however many
+ * cpus there are, and each new sample is one column of a few rectangles.
+ */
+#define HEAT_LEVELS 9
+static XftColor heat_colors[HEAT_LEVELS];
+static bool     heat_setup = false;
+
+/* blend from a to b, n/d of the way */
+static unsigned short
+heat_blend(unsigned short a, unsigned short b, int n, int d)
+{
+   return a + ((int)b - (int)a) * n / d;
+}
+
+static void
+heat_init()
+{
+   XRenderColor  c;
+   XRenderColor *from, *to;
+   int level, half = HEAT_LEVELS / 2;
+
+   for (level = 0; level < HEAT_LEVELS; level++) {
+      if (level <= half) {
+         from = &COLOR2.color;
+         to   = &COLOR3.color;
+         c.red   = heat_blend(from->red,   to->red,   level, half);
+         c.green = heat_blend(from->green, to->green, level, half);
+         c.blue  = heat_blend(from->blue,  to->blue,  level, half);
+      } else {
+         from = &COLOR3.color;
+         to   = &COLOR1.color;
+         c.red   = heat_blend(from->red,   to->red,   level - half, half);
+         c.green = heat_blend(from->green, to->green, level - half, half);
+         c.blue  = heat_blend(from->blue,  to->blue,  level - half, half);
+      }
+      c.alpha = 0xffff;
+
+      XftColorAllocValue(XINFO.disp, XINFO.vis,
+         DefaultColormap(XINFO.disp, XINFO.screen), &c, &heat_colors[level]);
+   }
+
+   heat_setup = true;
+}
+
+/* one column of the heatmap, by the busiest sample of each cpu in it */
+static void
+heat_column(graph_t *g, int col, long long column)
+{
+   int nbands, band, cpu, first, last;
+   int busy, sum, level, y0, run_y, run_level;
+
+   nbands = MIN(sysinfo.ncpu, g->height);
+   run_y = 0;
+   run_level = -1;
+
+   for (band = 0; band < nbands; band++) {
+      first = band * sysinfo.ncpu / nbands;
+      last  = (band + 1) * sysinfo.ncpu / nbands;
+
+      sum = 0;
+      for (cpu = first; cpu < last; cpu++) {
+         if (cpu_busiest(g, cpu, column, &busy))
+            sum += busy;
+      }
+      busy = sum / (last - first);
+
+      level = (busy * (HEAT_LEVELS - 1) + 50) / 100;
+      level = MAX(0, MIN(level, HEAT_LEVELS - 1));
+
+      /* rows of the same color go out as one rectangle */
+      y0 = band * g->height / nbands;
+      if (level != run_level) {
+         if (run_level != -1)
+            graph_rect(g, col, run_y, y0 - run_y, &heat_colors[run_level]);
+         run_y = y0;
+         run_level = level;
+      }
+   }
+
+   graph_rect(g, col, run_y, g->height - run_y, &heat_colors[run_level]);
+}
+
+/*
+ * the heatmap of all cpus, "width" pixels wide, followed by the
+ * percentages for all of them together
+ */
+int
+cpu_heatmap_draw(XftColor *color, int x, int y, int width, bool compact)
+{
+   static graph_t graph;
+   int startx;
+
+   startx = x;
+
+   if (!heat_setup) {
+      heat_init();
+      graph_init(&graph, &COLOR2, heat_column, 0);
+   }
+
+   x += render_text(color, x, y, "cpus: ") + 1;
+
+   graph_update(&graph, hist_view(&graph, &sysinfo.cpu_hist, cpu_window, width),
+      width);
+   graph_blit(&graph, x);
+   x += graph.width + 1;
+
+   if (!compact)
+      x += cpu_text(-1, x, y);
+
+   return x - startx;
+}
+
+/*
+ * one column of the memory graph, by the means, over g->scale: in use
+ * (yellow), with the active part of it (red) drawn inside
+ */
+static void
+mem_column(graph_t *g, int col, long long column)
+{
+   static XftColor *colors[] = { &COLOR3, &COLOR1 };
+   int bars[2] = { 0, 0 };
+   int mem[3], min, max, i;
+
+   for (i = 0; i < 3; i++) {
+      if (!hist_column(g, &sysinfo.mem_hist, i, column, &min, &max, &mem[i]))
+         mem[i] = 0;
+   }
+
+   if (mem[MEM_ACT] != 0 || mem[MEM_TOT] != 0 || mem[MEM_FRE] != 0) {
+
+      /* yellow (in use) bar */
+      bars[0] = (long long)mem[MEM_TOT] * g->height / g->scale;
+      bars[0] = MIN(bars[0], g->height);
+
+      /* red (active) bar */
+      bars[1] = (long long)mem[MEM_ACT] * g->height / g->scale;
+      bars[1] = MIN(bars[1], g->height);
+   }
+
+   graph_bar(g, col, 2, bars, colors);
+}
+
+int
+mem_draw(XftColor *color, int x, int y, bool compact)
+{
+   static graph_t graph;
+   static bool    graph_setup = false;
+   int total;
+   int startx;
+   int cur;
+
+   startx = x;
+   cur = sysinfo.mem_current;
+
+   if (!graph_setup) {
+      graph_init(&graph, &COLOR2, mem_column, 0);
+      graph_setup = true;
+   }
+
+   /*
+    * every column is scaled by the physical memory, which stays put, so
+    * the graph only has to be repainted should it change.  (the sum of
+    * the series changes with nearly every sample.)  what is in use can't
+    * be more than that, so the bars only reach the top when it is all
+    * used.
+    */
+   total = sysinfo.mem_physical;
+   if (total <= 0)
+      total = MEM_HIST(MEM_ACT)[cur]
+            + MEM_HIST(MEM_TOT)[cur]
+            + MEM_HIST(MEM_FRE)[cur];
+
+   /* start drawing ... */
+   x += render_text(color, x, y, "mem: ") + 1;
+
+   /* rescale on change */
+   if (graph.scale != total) {
+      graph.scale = total;
+      graph_invalidate(&graph);
+   }
+   graph_update(&graph, hist_view(&graph, &sysinfo.mem_hist, mem_window,
+      graph_width), graph_width);
+   graph_blit(&graph, x);
+   x += graph.width + 1;
+   if (compact)
+      return x - startx;
+
+   /* draw numbers */
+   x += render_text(&COLOR1, x, y, fmtmem(MEM_HIST(MEM_ACT)[cur]));
+   x += render_text(color, x, y, "/");
+   x += render_text(&COLOR3, x, y, fmtmem(MEM_HIST(MEM_TOT)[cur]));
+   x += render_text(color, x, y, "/");
+   x += render_text(&COLOR2, x, y, fmtmem(MEM_HIST(MEM_FRE)[cur]));
+
+   /* draw swap, if any is used */
+   if (sysinfo.swap_used > 0) {
+      x += render_text(color, x, y, " swap:");
+      x += render_text(&COLOR1, x, y, fmtmem(sysinfo.swap_used));
+      x += render_text(color, x, y, "/");
+      x += render_text(&COLOR2, x, y, fmtmem(sysinfo.swap_total));
+   }
+
+   return x - startx;
+}
+
+int
+procs_draw(XftColor *color, int x, int y, bool compact)
+{
+   static char str[1000];
+   int startx;
+
+   startx = x;
+   x += render_text(color, x, y, "procs: ");
+
+   /* FIXME finish getting the number of active processes
+    * i, personally, like this...
+   snprintf(str, sizeof(str), "%d", sysinfo.procs_active);
+   x += render_text(COLOR1, x, y, str);
+
+   x += render_text(color, x, y, "/");
+   */
+
+   snprintf(str, sizeof(str), "%d", sysinfo.procs_total);
+   x += render_text(&COLOR1, x, y, str);
+
+   return x - startx;
+}
+
+
+/*****************************************************************************
+ * time
+ ****************************************************************************/
+
+int
+time_draw(XftColor *color, int x, int y, bool compact)
+{
+   return render_text(color, x, y, timeinfo.str);
+}
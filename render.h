@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "xstatbar.h"
+#include "graph.h"
+#include "batch.h"
+#include "text.h"
+
+/*
+ * The following are used to draw the stats (see stats.h) onto the bar
+ * being drawn.  Each takes a color that is used for coloring the TEXT and
+ * the text only.  Additionally, they take an (x,y) for where to start
+ * drawing their stats.  They each return the width, in pixels, of what
+ * they drew.  Compact, they leave out what they can (the numbers next to
+ * the graphs) for a narrow bar; see layout.h.
+ *
+ * This, and all of X, is left out of the headless build (see stream.h).
+ */
+
+int  volume_draw(XftColor *c, int x, int y, bool compact);
+int  power_draw(XftColor *c, int x, int y, bool compact);
+int  cpu_draw(int cpu, XftColor *c, int x, int y, bool compact);
+int  cpu_heatmap_draw(XftColor *c, int x, int y, int width, bool compact);
+int  mem_draw(XftColor *c, int x, int y, bool compact);
+int  procs_draw(XftColor *c, int x, int y, bool compact);
+int  time_draw(XftColor *c, int x, int y, bool compact);
+
+#endif
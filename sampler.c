@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <poll.h>
+#include <limits.h>
+#include <errno.h>
+
+#include "stats.h"
+#include "sampler.h"
+#include "profile.h"
+
+/*
+ * The snapshots.  The sampler thread fills in the one it holds (back),
+ * and the main thread reads the one it holds (front) in place; neither
+ * ever touches the other's.  They change hands through the third
+ * (middle): publishing swaps back for it, and a read swaps front for it
+ * if it is newer than front.  So it's a double buffer that swaps indices,
+ * with one more buffer so that neither thread waits for the other.
+ *
+ * The back snapshot is a copy of the stats as they were some samples ago,
+ * so it is only brought up to date (see sysinfo_sync()).
+ */
+typedef struct {
+   volume_info_t  volume;
+   power_info_t   power;
+   time_info_t    timeinfo;
+   sysinfo_t      sysinfo;
+} snapshot_t;
+
+#define SNAP_FRESH 4     /* in middle: published since the last read */
+
+static snapshot_t    snaps[3];
+static int           back = 0;       /* the sampler thread's */
+static int           front = 1;      /* the main thread's */
+static unsigned int  middle = 2;     /* either's, atomically */
+
+static pthread_t     thread;
+static int           notify[2];      /* sampler -> main: new snapshot */
+static int           ctl[2];         /* main -> sampler: 'q'uit, 'r'esize */
+static int           resize_to;      /* the history size 'r' is for */
+
+static widget_t     *table;
+static int           ntable;
+static int           hist;
+
+static void
+set_nonblock(int fd)
+{
+   int flags;
+
+   if ((flags = fcntl(fd, F_GETFL)) == -1
+   ||  fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+      err(1, "sampler: fcntl");
+}
+
+/* copy this thread's stats into a snapshot and tell the main thread */
+static void
+publish()
+{
+   snapshot_t *s = &snaps[back];
+
+   s->volume   = volume;
+   s->power    = power;
+   s->timeinfo = timeinfo;
+   sysinfo_sync(&s->sysinfo, &sysinfo);
+
+   back = __atomic_exchange_n(&middle, back | SNAP_FRESH, __ATOMIC_ACQ_REL)
+        & ~SNAP_FRESH;
+   PROFILE_ADD(profile.publishes, 1);
+
+   /* if the pipe is full, the main thread has a wakeup pending anyway */
+   if (write(notify[1], "", 1) == -1 && errno != EAGAIN)
+      err(1, "sampler: write");
+}
+
+/*
+ * the sampler thread: run the updates on their deadlines, and those of
+ * evented widgets as soon as their fd says so, until told to stop
+ */
+static void *
+sampler_main(void *arg)
+{
+   struct pollfd *pfd;
+   widget_t **evented;
+   long long now, next;
+   char cmd[64];
+   bool fresh;
+   ssize_t n;
+   int npfd, i;
+
+   for (i = 0; i < ntable; i++) {
+      if (table[i].enabled && table[i].init != NULL)
+         table[i].init();
+   }
+   sysinfo_init(hist);
+
+   /* the first fd is for being told what to do, then one per evented widget */
+   pfd = calloc(ntable + 1, sizeof(struct pollfd));
+   evented = calloc(ntable + 1, sizeof(widget_t *));
+   if (pfd == NULL || evented == NULL)
+      err(1, "sampler: calloc failed");
+
+   pfd[0].fd = ctl[0];
+   pfd[0].events = POLLIN;
+   npfd = 1;
+   for (i = 0; i < ntable; i++) {
+      table[i].evented = false;
+      if (!table[i].enabled || table[i].fd == NULL
+      ||  (pfd[npfd].fd = table[i].fd()) == -1)
+         continue;
+
+      table[i].evented = true;
+      pfd[npfd].events = POLLIN;
+      evented[npfd++] = &table[i];
+   }
+   sched_init(table, ntable, sched_now());
+
+   while (1) {
+      fresh = false;
+
+      now = sched_now();
+      if (now >= sched_next()) {
+         PROFILE_ADD(profile.ticks, 1);
+         fresh = sched_run(now);
+      }
+
+      for (i = 1; i < npfd; i++) {
+         if (pfd[i].revents == 0)
+            continue;
+         pfd[i].revents = 0;
+
+         if (widget_event(evented[i]))
+            fresh = true;
+         /* the widget may have lost its fd (-1 is ignored by poll) */
+         pfd[i].fd = evented[i]->fd();
+      }
+
+      if (fresh)
+         publish();
+
+      next = sched_next();
+      now  = sched_now();
+      if (poll(pfd, npfd, next == LLONG_MAX ? -1 : (int)MAX(0, next - now))
+          == -1) {
+         if (errno == EINTR)
+            continue;
+         err(1, "sampler: poll");
+      }
+      if (pfd[0].revents & POLLIN) {
+         if ((n = read(ctl[0], cmd, sizeof(cmd))) == -1)
+            err(1, "sampler: read");
+         if (n == 0 || memchr(cmd, 'q', n) != NULL)
+            break;
+
+         /* the graphs changed: keep as much history as they need now */
+         sysinfo_resize(__atomic_load_n(&resize_to, __ATOMIC_ACQUIRE));
+         publish();
+      }
+   }
+
+   for (i = 0; i < ntable; i++) {
+      if (table[i].enabled && table[i].close != NULL)
+         table[i].close();
+   }
+   sysinfo_close();
+   free(pfd);
+   free(evented);
+   return NULL;
+}
+
+/*
+ * start sampling.  returns once the first snapshot is published, so that
+ * sampler_read() has something to read (the number of cpus, in particular).
+ */
+void
+sampler_start(widget_t *widgets, int nwidgets, int hist_size)
+{
+   struct pollfd pfd;
+   sigset_t all, old;
+
+   table  = widgets;
+   ntable = nwidgets;
+   hist   = hist_size;
+
+   if (pipe(notify) == -1 || pipe(ctl) == -1)
+      err(1, "sampler: pipe");
+   set_nonblock(notify[0]);
+   set_nonblock(notify[1]);
+
+   /* signals are for the main thread */
+   sigfillset(&all);
+   pthread_sigmask(SIG_SETMASK, &all, &old);
+   errno = pthread_create(&thread, NULL, sampler_main, NULL);
+   if (errno != 0)
+      err(1, "sampler: pthread_create");
+   pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+   pfd.fd = notify[0];
+   pfd.events = POLLIN;
+   while (poll(&pfd, 1, -1) == -1) {
+      if (errno != EINTR)
+         err(1, "sampler: poll");
+   }
+}
+
+/* readable whenever there's a new snapshot for sampler_read() */
+int
+sampler_fd()
+{
+   return notify[0];
+}
+
+/*
+ * take the latest snapshot as this thread's stats.  returns true if it is
+ * one that wasn't read before.  the history isn't copied: this thread's
+ * sysinfo points into the snapshot's, which stays put until the next read.
+ */
+bool
+sampler_read()
+{
+   char buf[64];
+   snapshot_t *s;
+
+   while (read(notify[0], buf, sizeof(buf)) > 0)
+      ;
+
+   if (!(__atomic_load_n(&middle, __ATOMIC_ACQUIRE) & SNAP_FRESH))
+      return false;
+   front = __atomic_exchange_n(&middle, front, __ATOMIC_ACQ_REL)
+         & ~SNAP_FRESH;
+
+   s = &snaps[front];
+   volume   = s->volume;
+   power    = s->power;
+   timeinfo = s->timeinfo;
+   sysinfo  = s->sysinfo;
+   return true;
+}
+
+/*
+ * have the sampler keep hist_size samples of history from now on, and
+ * publish it (see sysinfo_resize())
+ */
+void
+sampler_resize(int hist_size)
+{
+   __atomic_store_n(&resize_to, hist_size, __ATOMIC_RELEASE);
+   if (write(ctl[1], "r", 1) == -1)
+      err(1, "sampler: write");
+}
+
+/* stop the sampler thread, which closes everything it opened */
+void
+sampler_stop()
+{
+   int i;
+
+   if (write(ctl[1], "q", 1) == -1)
+      err(1, "sampler: write");
+
+   errno = pthread_join(thread, NULL);
+   if (errno != 0)
+      err(1, "sampler: pthread_join");
+
+   for (i = 0; i < 3; i++) {
+      free(snaps[i].sysinfo.hist_block);
+      snaps[i].sysinfo.hist_block = NULL;
+   }
+   sysinfo.hist_block = NULL;
+}
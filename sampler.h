@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stdbool.h>
+
+#include "sched.h"
+
+/*
+ * The widget updates run on a thread of their own, so a slow sysctl(3)
+ * or ioctl(2) can't hold up drawing.  Whenever a run of updates
+ * produced something new, the sampler thread publishes a snapshot of its
+ * stats (see stats.h) by swapping buffers, and makes sampler_fd()
+ * readable.  The main thread then takes that snapshot over with
+ * sampler_read(), without ever blocking on the sampler or copying it.
+ */
+
+void  sampler_start(widget_t *widgets, int nwidgets, int hist_size);
+int   sampler_fd();
+bool  sampler_read();
+void  sampler_resize(int hist_size);
+void  sampler_stop();
+
+#endif
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/param.h>
+#include <time.h>
+#include <limits.h>
+#include <err.h>
+
+#include "sched.h"
+
+static widget_t *table = NULL;
+static int          ntable = 0;
+
+/*
+ * how early a widget may be run to share a wakeup with another.  never for
+ * those on the wall clock, which would only see the unit before.
+ */
+#define SLACK(c)  ((c)->aligned ? 0 : (c)->period / 8)
+
+/*
+ * how long a widget on the wall clock may sleep without looking at it: a
+ * monotonic deadline can't see the clock being set, so one for a whole
+ * day would show the wrong date until then
+ */
+#define WALL_CHECK 60000
+
+/*
+ * the time since boot counts suspend where there is one, so what came
+ * due while suspended runs right on resume
+ */
+#ifdef CLOCK_BOOTTIME
+#define SCHED_CLOCK CLOCK_BOOTTIME
+#else
+#define SCHED_CLOCK CLOCK_MONOTONIC
+#endif
+
+static long long
+clock_ms(clockid_t clock)
+{
+   struct timespec ts;
+
+   if (clock_gettime(clock, &ts) == -1)
+      err(1, "clock_gettime");
+
+   return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* milliseconds on the scheduler's clock */
+long long
+sched_now()
+{
+   return clock_ms(SCHED_CLOCK);
+}
+
+/*
+ * the wall clock time (in milliseconds since the epoch) of the next
+ * multiple of period after wall on the local wall clock, counted from
+ * midnight (so period must divide a day).  one more, so the clock is
+ * sure to have rolled over by then.
+ */
+static long long
+wall_next(long long wall, int period)
+{
+   struct tm tm;
+   time_t t = wall / 1000;
+   long long into;
+
+   localtime_r(&t, &tm);
+   into = ((long long)(tm.tm_hour * 60 + tm.tm_min) * 60 + tm.tm_sec) * 1000
+        + wall % 1000;
+   return wall + period - into % period + 1;
+}
+
+/* whether the scheduler runs w at all */
+#define SCHEDULED(w) \
+   ((w)->enabled && (w)->update != NULL && (!(w)->evented || (w)->fd_poll))
+
+void
+sched_init(widget_t *widgets, int nwidgets, long long now)
+{
+   int i;
+
+   table  = widgets;
+   ntable = nwidgets;
+
+   /* everything runs right away, then settles onto its own period */
+   for (i = 0; i < ntable; i++) {
+      table[i].due = SCHEDULED(&table[i]) ? now : LLONG_MAX;
+      table[i].wall_due = 0;
+   }
+}
+
+/* the earliest deadline of all widgets */
+long long
+sched_next()
+{
+   long long next;
+   int i;
+
+   next = table[0].due;
+   for (i = 1; i < ntable; i++) {
+      if (table[i].due < next)
+         next = table[i].due;
+   }
+
+   return next;
+}
+
+/*
+ * run every widget update that is due (or nearly so).  returns true if
+ * any of them produced new data, i.e. the bar needs redrawing.
+ */
+bool
+sched_run(long long now)
+{
+   widget_t *c;
+   long long wall;
+   bool fresh = false;
+   int i;
+
+   for (i = 0; i < ntable; i++) {
+      c = &table[i];
+      if (!SCHEDULED(c) || c->due - SLACK(c) > now)
+         continue;
+
+      /*
+       * on the wall clock, the deadline is only a guess: that clock may
+       * have been set since.  if it isn't time yet (and wasn't set back
+       * by more than a period), sleep on until it is.
+       */
+      if (c->aligned) {
+         wall = clock_ms(CLOCK_REALTIME);
+         if (wall < c->wall_due && c->wall_due - wall <= c->period + 1) {
+            c->due = now + MIN(c->wall_due - wall, WALL_CHECK);
+            continue;
+         }
+      }
+
+      if (widget_update(c))
+         fresh = true;
+
+      /* next deadline on the widget's grid, skipping any missed */
+      if (c->aligned) {
+         wall = clock_ms(CLOCK_REALTIME);
+         c->wall_due = wall_next(wall, c->period);
+         c->due = now + MIN(c->wall_due - wall, WALL_CHECK);
+      } else if (c->due <= now)
+         c->due += c->period * ((now - c->due) / c->period + 1);
+      else
+         c->due += c->period;
+   }
+
+   return fresh;
+}
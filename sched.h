@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdbool.h>
+
+#include "widget.h"
+
+/*
+ * A tiny scheduler for the widget updates.  Each widget has its own
+ * period; deadlines are absolute (in milliseconds on a monotonic clock)
+ * and kept on each widget's own grid, so they don't drift.  To keep
+ * wakeups down, a run also takes along any widget due within a small
+ * slack of now.  A widget may instead be aligned to the wall clock, to
+ * be run right as each multiple of its period (since midnight) begins.
+ * Its deadline is checked against the wall clock when it comes up, and
+ * at least every minute, so the clock being set or a suspend (which the
+ * deadlines count, where the system has CLOCK_BOOTTIME) throw it off by
+ * no more than that.
+ * Disabled widgets, those without an update and those updated on their
+ * fd (unless they asked to be polled as well) are never run.
+ */
+
+long long sched_now();
+void      sched_init(widget_t *widgets, int nwidgets, long long now);
+long long sched_next();
+bool      sched_run(long long now);
+
+#endif
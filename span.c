@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include <stdlib.h>
+
+#include "ticks.h"
+#include "span.h"
+
+#if defined(__x86_64__)
+#define SPAN_X86
+#include <immintrin.h>
+#endif
+
+typedef void (*span_kernel_t)(uint32_t *p, int n, uint32_t pixel);
+
+/* a plain loop, as it was; what the compiler makes of it */
+static void
+scalar_fill(uint32_t *p, int n, uint32_t pixel)
+{
+   int i;
+
+   for (i = 0; i < n; i++)
+      p[i] = pixel;
+}
+
+#ifdef SPAN_X86
+/* 8 pixels a loop, then the last 4 wherever they start */
+static void
+sse2_fill(uint32_t *p, int n, uint32_t pixel)
+{
+   __m128i v;
+   int i;
+
+   if (n < 4) {
+      scalar_fill(p, n, pixel);
+      return;
+   }
+
+   v = _mm_set1_epi32(pixel);
+   for (i = 0; i + 8 <= n; i += 8) {
+      _mm_storeu_si128((__m128i *)(p + i), v);
+      _mm_storeu_si128((__m128i *)(p + i + 4), v);
+   }
+   if (i + 4 <= n)
+      _mm_storeu_si128((__m128i *)(p + i), v);
+   _mm_storeu_si128((__m128i *)(p + n - 4), v);
+}
+
+/* 16 pixels a loop, then the last 8 (or 4) wherever they start */
+__attribute__((target("avx2")))
+static void
+avx2_fill(uint32_t *p, int n, uint32_t pixel)
+{
+   __m256i v;
+   int i;
+
+   if (n < 8) {
+      sse2_fill(p, n, pixel);
+      return;
+   }
+
+   v = _mm256_set1_epi32(pixel);
+   for (i = 0; i + 16 <= n; i += 16) {
+      _mm256_storeu_si256((__m256i *)(p + i), v);
+      _mm256_storeu_si256((__m256i *)(p + i + 8), v);
+   }
+   if (i + 8 <= n)
+      _mm256_storeu_si256((__m256i *)(p + i), v);
+   _mm256_storeu_si256((__m256i *)(p + n - 8), v);
+}
+#endif /* SPAN_X86 */
+
+static const span_kernel_t kernels[TICKS_KERNELS] = {
+   scalar_fill,
+#ifdef SPAN_X86
+   sse2_fill,
+   avx2_fill,
+#else
+   NULL,
+   NULL,
+#endif
+};
+
+static int           current = -1;
+static span_kernel_t fill = NULL;
+
+bool
+span_use(int kernel)
+{
+   if (!ticks_supported(kernel) || kernels[kernel] == NULL)
+      return false;
+
+   current = kernel;
+   fill = kernels[kernel];
+   return true;
+}
+
+int
+span_kernel()
+{
+   int k;
+
+   /* the best the cpu has */
+   if (current == -1) {
+      for (k = TICKS_KERNELS - 1; k > TICKS_SCALAR && !span_use(k); k--)
+         ;
+      span_use(k);
+   }
+
+   return current;
+}
+
+void
+span_fill(uint32_t *p, int n, uint32_t pixel)
+{
+   if (fill == NULL)
+      span_kernel();
+   fill(p, n, pixel);
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef SPAN_H
+#define SPAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Filling spans of ARGB pixels, the kernel everything the client side
+ * rasterizing (see raster.h) comes down to: the rows of a rectangle, the
+ * bars of a graph column.  Most are short, a graph's height or a meter's
+ * width.
+ *
+ * Like the tick kernels (see ticks.h) there is one in plain C, and ones
+ * with SSE2 and AVX2 that store 4 or 8 pixels at a time, the last of them
+ * overlapping the ones before rather than going on a pixel at a time.
+ * They are the same TICKS_* kinds, and the best the cpu has is picked on
+ * the first call.
+ */
+
+/* fill n pixels from p */
+void        span_fill(uint32_t *p, int n, uint32_t pixel);
+
+/* the kernel in use; span_use() is false if the cpu can't run that one */
+int         span_kernel();
+bool        span_use(int kernel);
+
+#endif
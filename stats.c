@@ -1,7 +1,5 @@
 /*
  * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
- *  audio/volume by   Jacob Meuser <jakemsr@sdf.lonestar.org>
- *  patch by          Antoine Jacoutot <ajacoutot@openbsd.org>
  *  misc updates by   Dmitrij D. Czarkoff <czarkoff@gmail.cim>
  *  cpu consolidation Martin Brandenburg <martin@martinbrandenburg.com>
  *
@@ -18,26 +16,29 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <time.h>
+
 #include "stats.h"
+#include "history.h"
+#include "ticks.h"
 
 /* extern's from stats.h */
-volume_info_t volume;
-power_info_t power;
-sysinfo_t sysinfo;
+__thread volume_info_t volume;
+__thread power_info_t power;
+__thread sysinfo_t sysinfo;
+__thread time_info_t timeinfo;
 brightness_info_t brightness;
 char *time_fmt;
+unsigned long stat_syscalls = 0;
 
 
-/* draw text in a given color at a given (x,y) */
-int
-render_text(XftColor *c, int x, int y, const char *str)
+/* fold a value into a widget's state hash (FNV-1a, word at a time) */
+static unsigned long
+hash_mix(unsigned long h, unsigned long v)
 {
-   XGlyphInfo extents;
-   XftTextExtents8( XINFO.disp, XINFO.font, (XftChar8 *)str, strlen(str), &extents );
-
-   XftDrawString8(XINFO.xftdraw, c, XINFO.font, x, y, (XftChar8 *)str, strlen(str));
-   return extents.width;
+   return (h ^ v) * 16777619UL;
 }
+#define HASH_INIT 2166136261UL
 
 /* format memory (measured in kilobytes) for display */
 char *
@@ -65,619 +66,578 @@ fmtmem(int m)
  * volume stuff
  ****************************************************************************/
 
-int
-volume_check_dev(int fd, int class, char *name)
+unsigned long
+volume_hash()
 {
-   mixer_devinfo_t devinfo;
-
-   if (class < 0 || name == NULL)
-      return (-1);
-
-   devinfo.index = 0;
-   while (ioctl(fd, AUDIO_MIXER_DEVINFO, &devinfo) >= 0) {
-      if ((devinfo.type == AUDIO_MIXER_VALUE)
-      &&  (devinfo.mixer_class == class)
-      &&  (strncmp(devinfo.label.name, name, MAX_AUDIO_DEV_LEN) == 0))
-         return (devinfo.index);
-
-      devinfo.index++;
-   }
+   unsigned long h = HASH_INIT;
 
-   return (-1);
+   h = hash_mix(h, volume.is_setup);
+   h = hash_mix(h, volume.left);
+   h = hash_mix(h, volume.right);
+   h = hash_mix(h, volume.muted);
+   return h;
 }
 
-void
-volume_init()
-{
-   mixer_devinfo_t devinfo;
-   int oclass_idx, iclass_idx;
-
-   volume.is_setup = false;
-
-   /* open mixer */
-   if ((volume.dev_fd = open("/dev/mixer", O_RDWR)) < 0) {
-      warn("volume: failed to open /dev/mixer");
-      return;
-   }
 
-   /* find the outputs and inputs classes */
-   oclass_idx = iclass_idx = -1;
-   devinfo.index = 0;
-   while (ioctl(volume.dev_fd, AUDIO_MIXER_DEVINFO, &devinfo) >= 0) {
+/*****************************************************************************
+ * power stuff
+ ****************************************************************************/
 
-      if (devinfo.type != AUDIO_MIXER_CLASS) {
-         devinfo.index++;
-         continue;
-	  }
+unsigned long
+power_hash()
+{
+   unsigned long h = HASH_INIT;
 
-      if (strncmp(devinfo.label.name, AudioCoutputs, MAX_AUDIO_DEV_LEN) == 0)
-         oclass_idx = devinfo.index;
-      if (strncmp(devinfo.label.name, AudioCinputs, MAX_AUDIO_DEV_LEN) == 0)
-         iclass_idx = devinfo.index;
+   h = hash_mix(h, power.is_setup);
+   h = hash_mix(h, power.ac_state);
+   h = hash_mix(h, power.battery_life);
+   h = hash_mix(h, power.minutes_left);
+   return h;
+}
 
-      if (oclass_idx != -1 && iclass_idx != -1)
-         break;
 
-      devinfo.index++;
-   }
+/*****************************************************************************
+ * sysinf stuff (cpu/mem/procs)
+ ****************************************************************************/
 
-   /* find the master device */
-   volume.master_idx = volume_check_dev(volume.dev_fd, oclass_idx, AudioNmaster);
-   if (volume.master_idx == -1)
-      volume.master_idx = volume_check_dev(volume.dev_fd, iclass_idx, AudioNdac);
-   if (volume.master_idx == -1)
-      volume.master_idx = volume_check_dev(volume.dev_fd, oclass_idx, AudioNdac);
-   if (volume.master_idx == -1)
-      volume.master_idx = volume_check_dev(volume.dev_fd, oclass_idx, AudioNoutput);
-
-   if (volume.master_idx == -1) {
-      warnx("volume: failed to find \"master\" mixer device");
-      return;
-   }
+/* round a byte count up to a whole number of cache lines */
+#define CACHELINE 64
+#define CL_ROUND(n) (((n) + CACHELINE - 1) & ~((size_t)CACHELINE - 1))
 
-   devinfo.index = volume.master_idx;
-   if (ioctl(volume.dev_fd, AUDIO_MIXER_DEVINFO, &devinfo) == -1) {
-      warn("AUDIO_MIXER_DEVINFO");
-      return;
+/* point a hist_t at its tiers and data in the history block */
+static void
+hist_setup(hist_t *h, int nseries, char *block, const history_layout_t *l,
+           int which)
+{
+   static const int factors[] = HIST_FACTORS;
+   int k;
+
+   h->nseries = nseries;
+   h->tiers   = (tier_t *)(block + l->tiers) + which * HIST_TIERS;
+   if (which == HISTORY_CPU) {
+      h->raw    = (int *)(block + l->cpu);
+      h->rollup = (int *)(block + l->cpu_rollup);
+      h->sums   = (int64_t *)(block + l->cpu_sums);
+   } else {
+      h->raw    = (int *)(block + l->memory);
+      h->rollup = (int *)(block + l->mem_rollup);
+      h->sums   = (int64_t *)(block + l->mem_sums);
    }
 
-   volume.max = AUDIO_MAX_GAIN;
-   volume.nchan = devinfo.un.v.num_channels;
+   for (k = 0; k < HIST_TIERS; k++)
+      h->tiers[k].factor = factors[k];
+}
 
-   /* finished... now close the device and reopen as read only */
-   close(volume.dev_fd);
-   volume.dev_fd = open("/dev/mixer", O_RDONLY);
-   if (volume.dev_fd < 0) {
-      warn("volume: failed to re-open /dev/mixer");
-      return;
+/*
+ * allocate (zeroed) the single history block for hist_size samples and
+ * point the sysinfo series at it.  the block is mapped from the history
+ * file if there is one, in which case *restored says whether it already
+ * holds samples.
+ */
+static void
+sysinfo_hist_alloc(int hist_size, bool *restored)
+{
+   history_layout_t l;
+   void  *block;
+   size_t ncpu_series, off;
+
+   /* everything starts on a cache line */
+   ncpu_series = (1 + sysinfo.ncpu) * CPUSTATES;
+   off = 0;
+#define PLACE(field, bytes) \
+   do { l.field = off; off += CL_ROUND(bytes); } while (0)
+   PLACE(tiers,      2 * HIST_TIERS * sizeof(tier_t));
+   PLACE(raw,        2 * sysinfo.ncpu * CPUSTATES * sizeof(uint64_t));
+   PLACE(memory,     3 * hist_size * sizeof(int));
+   PLACE(cpu,        ncpu_series * hist_size * sizeof(int));
+   PLACE(mem_rollup, (HIST_TIERS - 1) * 3 * 3 * hist_size * sizeof(int));
+   PLACE(mem_sums,   (HIST_TIERS - 1) * 3 * sizeof(int64_t));
+   PLACE(cpu_rollup, (HIST_TIERS - 1) * 3 * ncpu_series * hist_size * sizeof(int));
+   PLACE(cpu_sums,   (HIST_TIERS - 1) * ncpu_series * sizeof(int64_t));
+#undef PLACE
+   l.bytes = off;
+
+   block = history_open(hist_size, &l, restored);
+   if (block == NULL) {
+      if (posix_memalign(&block, CACHELINE, l.bytes))
+         err(1, "sysinfo init: history block allocation failed");
+      memset(block, 0, l.bytes);
    }
 
-   volume.is_setup = true;
+   sysinfo.hist_block = block;
+   sysinfo.hist_bytes = l.bytes;
+   sysinfo.hist_size  = hist_size;
+   sysinfo.cpu_raw    = (uint64_t *)((char *)block + l.raw);
+   hist_setup(&sysinfo.cpu_hist, ncpu_series, block, &l, HISTORY_CPU);
+   hist_setup(&sysinfo.mem_hist, 3, block, &l, HISTORY_MEM);
+   sysinfo.cpu_pcnts  = sysinfo.cpu_hist.raw;
+   sysinfo.memory     = sysinfo.mem_hist.raw;
 }
 
 void
-volume_update()
+sysinfo_init(int hist_size)
 {
-   static mixer_ctrl_t vinfo;
+   bool restored;
 
-   if (!volume.is_setup)
-      return;
+   /* starting column */
+   sysinfo.samples    = sysinfo.mem_samples = 0;
+   sysinfo.current    = sysinfo.mem_current = 0;
+   sysinfo.raw_slot   = 0;
+   sysinfo.resizes    = 0;
 
-   /* query info */
-   vinfo.dev = volume.master_idx;
-   vinfo.type = AUDIO_MIXER_VALUE;
-   vinfo.un.value.num_channels = volume.nchan;
-   if (ioctl(volume.dev_fd, AUDIO_MIXER_READ, &(vinfo)) < 0) {
-      warn("volume update: AUDIO_MIXER_READ");
-      return;
-   }
+   /* init process counters */
+   sysinfo.swap_used = sysinfo.swap_total = 0;
+   sysinfo.procs_active = sysinfo.procs_total = 0;
 
-   /* record in global struct */
-   if (volume.nchan == 1)
-      volume.left = volume.right = vinfo.un.value.level[AUDIO_MIXER_LEVEL_MONO];
-   else {
-      volume.left  = vinfo.un.value.level[AUDIO_MIXER_LEVEL_LEFT];
-      volume.right = vinfo.un.value.level[AUDIO_MIXER_LEVEL_RIGHT];
-   }
-}
+   /* number of cpu's, etc. */
+   sysinfo_sys_init();
 
-void
-volume_close() {
-   if (!volume.is_setup)
-      return;
+   /* allocate cpu & memory history, or pick it up from the history file */
+   sysinfo_hist_alloc(hist_size, &restored);
+   if (restored)
+      history_restore();
 
-   close(volume.dev_fd);
+   /* do an initial reading (needed to setup initial data for graphs) */
+   sysinfo_update();
 }
 
+/*
+ * start a new cpu sample: advance the history and flip the raw tick
+ * slots.  returns the slot the platform code should fill with the raw
+ * tick counters of every cpu, before calling cpu_sample_end().
+ */
 int
-volume_draw(XftColor *color, int x, int y)
+cpu_sample_begin()
 {
-   static char str[6];
-   float left, right;
-   int   lheight, rheight;
-   int   startx;
-   int   width = 5;  /* width of the bar-graphs */
-
-   if (!volume.is_setup)
-      return 0;
-
-   startx = x;
-   width = 5;
-
-   /* get volume as percents */
-   left  = roundf(100.0 * (float)volume.left  / (float)volume.max);
-   right = roundf(100.0 * (float)volume.right / (float)volume.max);
-
-   /* determine height of green-part of bar graphs */
-   lheight = (int)(left  * (float)XINFO.height / 100.0);
-   rheight = (int)(right * (float)XINFO.height / 100.0);
-
-   /* start drawing... */
-   x += render_text(color, x, y, "vol:");
-
-   /* left volume % */
-   snprintf(str, sizeof(str), "%d%%", (int)left);
-   x += render_text(color, x, y, str) + 1;
-
-   /* left graph */
-   XftDrawRect(XINFO.xftdraw, &COLOR1, x, 0, width, XINFO.height);
-   XftDrawRect(XINFO.xftdraw, &COLOR2, x, XINFO.height - lheight, width, lheight);
-   x += width + 1;
-
-   /* right graph */
-   XftDrawRect(XINFO.xftdraw, &COLOR1, x, 0, width, XINFO.height);
-   XftDrawRect(XINFO.xftdraw, &COLOR2, x, XINFO.height - rheight, width, lheight);
-   x += width + 1;
-
-   /* right volume % */
-   snprintf(str, sizeof(str), "%d%%", (int)right);
-   x += render_text(color, x, y, str);
-
-   return x - startx;
+   history_begin();
+   sysinfo.samples++;
+   sysinfo.current = (1 + sysinfo.current) % sysinfo.hist_size;
+   sysinfo.raw_slot = !sysinfo.raw_slot;
+   return sysinfo.raw_slot;
 }
 
-
-/*****************************************************************************
- * power stuff
- ****************************************************************************/
-
+/*
+ * convert the ticks since the previous sample to percentages, and average
+ * those over the cpus that were online (see ticks.h)
+ */
 void
-power_init()
+cpu_sample_end()
 {
-   power.is_setup = false;
+   const int *pct;
+   int        avg[CPUSTATES];
+   int        cpu, state;
+   int        cur;
 
-   power.dev_fd = open("/dev/apm", O_RDONLY);
-   if (power.dev_fd < 0) {
-      warn("power: failed to open /dev/apm");
-      return;
-   }
+   cur = sysinfo.current;
+   pct = ticks_percent(CPU_RAW(sysinfo.raw_slot, 0),
+      CPU_RAW(!sysinfo.raw_slot, 0), sysinfo.ncpu, avg);
 
-   power.is_setup = true;
+   for (state = 0; state < CPUSTATES; state++) {
+      for (cpu = 0; cpu < sysinfo.ncpu; cpu++)
+         CPU_HIST(cpu, state)[cur] = pct[state * sysinfo.ncpu + cpu];
+      CPU_HIST(-1, state)[cur] = avg[state];
+   }
+   hist_add(&sysinfo.cpu_hist, cur, sysinfo.samples);
+   history_end(HISTORY_CPU);
 }
 
-void
-power_update()
+/*
+ * likewise for a memory sample: returns the slot of the memory series the
+ * platform code should fill, before calling mem_sample_end()
+ */
+int
+mem_sample_begin()
 {
-   if (!power.is_setup)
-      return;
-
-   if (ioctl(power.dev_fd, APM_IOC_GETPOWER, &(power.info)) < 0)
-      warn("power update: APM_IOC_GETPOWER");
+   history_begin();
+   sysinfo.mem_samples++;
+   sysinfo.mem_current = (1 + sysinfo.mem_current) % sysinfo.hist_size;
+   return sysinfo.mem_current;
 }
 
 void
-power_close()
+mem_sample_end()
 {
-   if (!power.is_setup)
-      return;
-
-   close(power.dev_fd);
+   hist_add(&sysinfo.mem_hist, sysinfo.mem_current, sysinfo.mem_samples);
+   history_end(HISTORY_MEM);
 }
 
-int
-power_draw(XftColor *color, int x, int y)
+/* a series of a tier, in the rings of h, which are size long */
+static int *
+series_at(const hist_t *h, int size, int tier, int kind, int series)
 {
-   static char str[1000];
-   char *state;
-   int startx, width, h;
-
-   if (!power.is_setup)
-      return 0;
-
-   startx = x;
-   width = 5;
-
-   switch (power.info.ac_state) {
-      case APM_AC_OFF:
-         state = "BAT";
-         break;
-      case APM_AC_ON:
-         state = "AC";
-         break;
-      default:
-         return 0;
-         break;
-   }
-
-   /* draw the state */
-   snprintf(str, sizeof(str), "%s:", state);
-   x += render_text(color, x, y, str) + 1;
-
-   /* draw the graph */
-   h = power.info.battery_life * XINFO.height / 100;
-   XftDrawRect(XINFO.xftdraw, &COLOR1, x, 0, width, XINFO.height);
-   XftDrawRect(XINFO.xftdraw, &COLOR2, x, XINFO.height - h, width, h);
-
-   x += width + 1;
+   if (tier == 0)
+      return h->raw + series * size;
 
-   /* draw the percent and time remaining */
-   
-   snprintf(str, sizeof(str), (power.info.minutes_left != (u_int)-1) ? "(%d%%,%dm)"
-      : "(%d%%)", power.info.battery_life, power.info.minutes_left);
-
-   x += render_text(color, x, y, str);
-   return x - startx;
+   return h->rollup + (((tier - 1) * 3 + kind) * h->nseries + series) * size;
 }
 
+int *
+hist_series(const hist_t *h, int tier, int kind, int series)
+{
+   return series_at(h, sysinfo.hist_size, tier, kind, series);
+}
 
-/*****************************************************************************
- * sysinf stuff (cpu/mem/procs)
- ****************************************************************************/
-
+/*
+ * the sample at ring index cur is number "samples": it goes into the
+ * newest bucket of every tier, or begins a new one if that is full.  the
+ * sums are kept so the mean stays exact however many samples are in.
+ */
 void
-sysinfo_init(int hist_size)
+hist_add(hist_t *h, int cur, unsigned long samples)
 {
-   size_t size;
-   int mib[] = { CTL_HW, HW_NCPU };
-   int i, j, k;
-
-   /* history size and starting column */
-   sysinfo.current    = 0;
-   sysinfo.hist_size  = hist_size;
-
-   /* init process counters */
-   sysinfo.swap_used = sysinfo.swap_total = 0;
-   sysinfo.procs_active = sysinfo.procs_total = 0;
-
-   /* setup page-shift */
-   i = getpagesize();
-   sysinfo.pageshift = 0;
-   while (i > 1) {
-      sysinfo.pageshift++;
-      i >>= 1;
-   }
-   sysinfo.pageshift -= 10;
-
-   /* allocate memory history */
-   if ((sysinfo.memory = calloc(hist_size, sizeof(int*))) == NULL)
-      err(1, "sysinfo init: memory calloc failed");
-
-   for (i = 0; i < hist_size; i++) {
-      if ((sysinfo.memory[i] = calloc(3, sizeof(int))) == NULL)
-         err(1, "sysinfo init: memory[%d] calloc failed", i);
-
-      for (j = 0; j < 3; j++)
-         sysinfo.memory[i][j] = 0;
-   }
+   tier_t  *t;
+   int64_t *sums;
+   int     *min, *max, *mean;
+   int      k, s, v;
+   bool     begin;
+
+   h->tiers[0].current = cur;
+   h->tiers[0].buckets = samples;
+
+   for (k = 1; k < HIST_TIERS; k++) {
+      t = &h->tiers[k];
+      sums = h->sums + (k - 1) * h->nseries;
+
+      begin = (t->buckets == 0 || t->fill == t->factor);
+      if (begin) {
+         t->current = (t->current + 1) % sysinfo.hist_size;
+         t->fill = 0;
+         t->buckets++;
+      }
 
-   /* get number of cpu's */
-   size = sizeof(sysinfo.ncpu);
-   if (sysctl(mib, 2, &(sysinfo.ncpu), &size, NULL, 0) == -1)
-      err(1, "sysinfo init: sysctl HW.NCPU failed");
-
-   /* allocate cpu history */
-   sysinfo.cpu_raw   = calloc(sysinfo.ncpu, sizeof(uint64_t**));
-   sysinfo.cpu_pcnts = calloc(sysinfo.ncpu, sizeof(int**));
-   if (sysinfo.cpu_raw == NULL || sysinfo.cpu_pcnts == NULL)
-      err(1, "sysinfo init: cpu_raw/cpu_pcnts calloc failed");
-
-   for (i = 0; i < sysinfo.ncpu; i++) {
-      sysinfo.cpu_raw[i]   = calloc(hist_size, sizeof(uint64_t*));
-      sysinfo.cpu_pcnts[i] = calloc(hist_size, sizeof(int*));
-      if (sysinfo.cpu_raw[i] == NULL || sysinfo.cpu_pcnts[i] == NULL)
-         err(1, "sysinfo init: cpu_raw/cpu_pcnts[%d] calloc failed", i);
-
-      for (j = 0; j < hist_size; j++) {
-         sysinfo.cpu_raw[i][j]   = calloc(CPUSTATES, sizeof(uint64_t));
-         sysinfo.cpu_pcnts[i][j] = calloc(CPUSTATES, sizeof(int));
-         if (sysinfo.cpu_raw[i][j] == NULL || sysinfo.cpu_pcnts[i][j] == NULL)
-            err(1, "sysinfo init: cpu_raw/cpu_pcnts[%d][%d] calloc failed", i, j);
-
-         for (k = 0; k < CPUSTATES; k++) {
-            sysinfo.cpu_raw[i][j][k] = 0;
-            sysinfo.cpu_pcnts[i][j][k] = 0;
+      for (s = 0; s < h->nseries; s++) {
+         v    = h->raw[s * sysinfo.hist_size + cur];
+         min  = hist_series(h, k, TIER_MIN,  s) + t->current;
+         max  = hist_series(h, k, TIER_MAX,  s) + t->current;
+         mean = hist_series(h, k, TIER_MEAN, s) + t->current;
+
+         if (begin) {
+            *min = *max = v;
+            sums[s] = v;
+         } else {
+            *min = MIN(*min, v);
+            *max = MAX(*max, v);
+            sums[s] += v;
          }
+         *mean = sums[s] / (t->fill + 1);
       }
+      t->fill++;
    }
-
-   /* do an initial reading (needed to setup initial data for graphs) */
-   sysinfo_update();
 }
 
+/*
+ * n samples were never taken (xstatbar wasn't running): the coarser tiers
+ * move on as if they were all 0, in a few steps however long that was.
+ * the samples themselves (tier 0) are up to the caller.
+ */
 void
-sysinfo_update()
+hist_skip(hist_t *h, unsigned long n)
 {
-   static int mib_nprocs[] = { CTL_KERN, KERN_NPROCS };
-   static int mib_vm[] = { CTL_VM, VM_METER };
-   static int mib_cpus[] = { CTL_KERN, 0, 0 };
-   static int diffs[CPUSTATES] = { 0 };
-   struct vmtotal vminfo;
-   struct swapent *swapdev;
-   size_t    size;
-   int       cpu, state;
-   int       cur, prev;
-   int       nticks, nswaps;
-
-   /* update current column in historical data & figure out previous */
-   sysinfo.current = (1 + sysinfo.current) % sysinfo.hist_size;
-   cur  = sysinfo.current;
-   prev = (cur == 0 ? sysinfo.hist_size - 1 : cur - 1);
-
-
-   /* update number of total/active processes */
-   size = sizeof(sysinfo.procs_total);
-   if (sysctl(mib_nprocs, 2, &sysinfo.procs_total, &size, NULL, 0) == -1)
-      warn("sysinfo update: sysctl KERN.NPROCS");
-   /* TODO update procs_active here... is there easy way (sysctl)? */
-
-
-   /* update mem history */
-   size = sizeof(vminfo);
-   if (sysctl(mib_vm, 2, &vminfo, &size, NULL, 0) < 0)
-      err(1, "sysinfo update: VM.METER failed");
+   tier_t  *t;
+   unsigned long take, begun, i;
+   int      k, s, kind;
 
-   sysinfo.memory[cur][MEM_ACT] = vminfo.t_arm << sysinfo.pageshift;
-   sysinfo.memory[cur][MEM_TOT] = vminfo.t_rm << sysinfo.pageshift;
-   sysinfo.memory[cur][MEM_FRE] = vminfo.t_free << sysinfo.pageshift;
+   for (k = 1; k < HIST_TIERS; k++) {
+      t = &h->tiers[k];
+      if (t->buckets == 0)
+         continue;
 
-   /* get swap status */
-   sysinfo.swap_used = sysinfo.swap_total = 0;
-   if ((nswaps = swapctl(SWAP_NSWAP, 0, 0)) == 0) {
-      if ((swapdev = calloc(nswaps, sizeof(*swapdev))) == NULL)
-        err(1, "sysinfo update: swapdev calloc failed (%d)", nswaps);
-      if (swapctl(SWAP_STATS, swapdev, nswaps) == -1)
-        err(1, "sysinfo update: swapctl(SWAP_STATS) failed");
-
-      for (size = 0; size < nswaps; size++) {
-        if (swapdev[size].se_flags & SWF_ENABLE) {
-          sysinfo.swap_used  += swapdev[size].se_inuse / (1024 / DEV_BSIZE);
-          sysinfo.swap_total += swapdev[size].se_nblks / (1024 / DEV_BSIZE);
-        }
+      /* the rest of the newest bucket */
+      take = MIN(n, (unsigned long)(t->factor - t->fill));
+      if (take > 0) {
+         for (s = 0; s < h->nseries; s++) {
+            hist_series(h, k, TIER_MIN, s)[t->current] = 0;
+            hist_series(h, k, TIER_MEAN, s)[t->current] =
+               h->sums[(k - 1) * h->nseries + s] / (t->fill + take);
+         }
+         t->fill += take;
       }
-      free(swapdev);
-   }
+      if (take == n)
+         continue;
 
-   /* get states for each cpu. note this is raw # of ticks */
-   size = CPUSTATES * sizeof(int64_t);
-   if (sysinfo.ncpu > 1) {
-      mib_cpus[1] = KERN_CPTIME2;
-      for (cpu = 0; cpu < sysinfo.ncpu; cpu++) {
-         mib_cpus[2] = cpu;
-         if (sysctl(mib_cpus, 3, sysinfo.cpu_raw[cpu][cur], &size, NULL, 0) < 0)
-            err(1, "sysinfo update: KERN.CPTIME2.%d failed", cpu);
+      /* then empty buckets, the last maybe not yet full */
+      begun = (n - take + t->factor - 1) / t->factor;
+      for (i = 0; i < MIN(begun, (unsigned long)sysinfo.hist_size); i++) {
+         t->current = (t->current + 1) % sysinfo.hist_size;
+         for (kind = TIER_MIN; kind <= TIER_MEAN; kind++)
+            for (s = 0; s < h->nseries; s++)
+               hist_series(h, k, kind, s)[t->current] = 0;
       }
-   } else {
-      int i;
-      long cpu_raw_tmp[CPUSTATES];
-      size = sizeof(cpu_raw_tmp);
-      mib_cpus[1] = KERN_CPTIME;
-      
-      if (sysctl(mib_cpus, 2, cpu_raw_tmp, &size, NULL, 0) < 0)
-         err(1, "sysinfo update: KERN.CPTIME failed");
-
-      for (i = 0; i < CPUSTATES; i++)
-         sysinfo.cpu_raw[0][cur][i] = cpu_raw_tmp[i];
+      if (begun > i)
+         t->current = (t->current + (begun - i)) % sysinfo.hist_size;
+      for (s = 0; s < h->nseries; s++)
+         h->sums[(k - 1) * h->nseries + s] = 0;
+      t->fill = n - take - (begun - 1) * t->factor;
+      t->buckets += begun;
    }
+}
 
-   /* convert ticks to percentages */
-   for (cpu = 0; cpu < sysinfo.ncpu; cpu++) {
-      nticks = 0;
-      for (state = 0; state < CPUSTATES; state++) {
-         diffs[state] = sysinfo.cpu_raw[cpu][cur][state]
-                      - sysinfo.cpu_raw[cpu][prev][state];
-
-         if (diffs[state] < 0) {
-            diffs[state] = INT64_MAX
-                         - sysinfo.cpu_raw[cpu][prev][state]
-                         - sysinfo.cpu_raw[cpu][cur][state];
-         }
-         nticks += diffs[state];
-      }
+/*
+ * how many samples (and buckets) of each tier to keep so that a graph
+ * width pixels wide can go back window samples: just enough of the finest
+ * tier that needs at most 10 of its buckets per pixel, in whole pixels.
+ */
+int
+hist_size_for(int width, int window)
+{
+   static const int factors[] = HIST_FACTORS;
+   int k, need;
 
-      if (nticks == 0)
-         nticks = 1;
+   if (window <= width)
+      return width;
 
-      for (state = 0; state < CPUSTATES; state++) {
-         sysinfo.cpu_pcnts[cpu][cur][state] =
-            ((diffs[state] * 1000 + (nticks / 2)) / nticks) / 10;
-      }
+   for (k = 0; k < HIST_TIERS - 1; k++) {
+      if ((window + factors[k] - 1) / factors[k] <= 10 * width)
+         break;
    }
+
+   need = (window + factors[k] - 1) / factors[k];
+   return width * ((need + width - 1) / width);
+}
+
+/* everything, as one sample */
+void
+sysinfo_update()
+{
+   procs_update();
+   mem_update();
+   swap_update();
+   cpu_update();
 }
 
 void
 sysinfo_close()
 {
-   /* nothing now, but keep here in case */
+   sysinfo_sys_close();
+   if (history_mapped())
+      history_close();
+   else
+      free(sysinfo.hist_block);
+   sysinfo.hist_block = NULL;
 }
 
-int
-cpu_draw(int cpu, XftColor *color, int x, int y)
+/* where p, a pointer into src's history block, lands in dst's */
+#define REBASE(dst, src, p) \
+   (void *)((char *)(dst)->hist_block + ((char *)(p) - (char *)(src)->hist_block))
+
+/* point dst's history at block, where src's is copied or being copied */
+static void
+sysinfo_rebase(sysinfo_t *dst, const sysinfo_t *src, void *block)
 {
-   static char  str[1000];
-   static char *cpuStateNames[] = { "u", "n", "s", "i", "I" };
-   static XftColor *cpuStateColors[] = {
-     &COLOR1, &COLOR4, &COLOR3, &COLOR5, &COLOR2
-   };
-   int state, startx, time, col, h, i, j;
+   *dst = *src;
+   dst->hist_block = block;
+   dst->cpu_raw   = REBASE(dst, src, src->cpu_raw);
+   dst->memory    = REBASE(dst, src, src->memory);
+   dst->cpu_pcnts = REBASE(dst, src, src->cpu_pcnts);
+   dst->cpu_hist.tiers  = REBASE(dst, src, src->cpu_hist.tiers);
+   dst->cpu_hist.raw    = REBASE(dst, src, src->cpu_hist.raw);
+   dst->cpu_hist.rollup = REBASE(dst, src, src->cpu_hist.rollup);
+   dst->cpu_hist.sums   = REBASE(dst, src, src->cpu_hist.sums);
+   dst->mem_hist.tiers  = REBASE(dst, src, src->mem_hist.tiers);
+   dst->mem_hist.raw    = REBASE(dst, src, src->mem_hist.raw);
+   dst->mem_hist.rollup = REBASE(dst, src, src->mem_hist.rollup);
+   dst->mem_hist.sums   = REBASE(dst, src, src->mem_hist.sums);
+}
 
-   startx = x;
+/*
+ * copy the newest n entries of a ring of size, the newest at index last,
+ * to the start of dst, oldest first
+ */
+static void
+ring_move(int *dst, const int *src, int size, int last, int n)
+{
+   int first = (last - n + 1 + size) % size;
 
-   if (cpu == -1)
-      snprintf(str, sizeof(str), "cpu: ");
-   else
-      snprintf(str, sizeof(str), "cpu%d: ", cpu);
-   x += render_text(color, x, y, str) + 1;
-
-   /* for the graph, draw a green rectangle to start with */
-   XftDrawRect(XINFO.xftdraw, &COLOR2, x, 0, sysinfo.hist_size, XINFO.height);
-
-   /* start adding every 'bar' to the bar-graph... */
-   time = (sysinfo.current + 1) % sysinfo.hist_size;
-   for (col = 0; col < sysinfo.hist_size; col++) {
-
-      /* user time */
-      h = 0;
-      if (cpu == -1) {
-         for (i = 0; i < 4; i++)
-            for (j = 0; j < sysinfo.ncpu; j++)
-               h += sysinfo.cpu_pcnts[j][time][i];
-         h /= sysinfo.ncpu;
-      } else
-         for (i = 0; i < 4; i++) h += sysinfo.cpu_pcnts[cpu][time][i];
-      h = h * XINFO.height / 100;
-      XftDrawRect(XINFO.xftdraw, &COLOR1, x + col, XINFO.height - h, 1, h);
-
-      /* nice time */
-      h = 0;
-      if (cpu == -1) {
-         for (i = 1; i < 4; i++)
-            for (j = 0; j < sysinfo.ncpu; j++)
-               h += sysinfo.cpu_pcnts[j][time][i];
-         h /= sysinfo.ncpu;
-      } else
-         for (i = 1; i < 4; i++) h += sysinfo.cpu_pcnts[cpu][time][i];
-      h = h * XINFO.height / 100;
-      XftDrawRect(XINFO.xftdraw, &COLOR4, x + col, XINFO.height - h, 1, h);
-
-      /* system time */
-      h = 0;
-      if (cpu == -1) {
-         for (i = 2; i < 4; i++)
-            for (j = 0; j < sysinfo.ncpu; j++)
-               h += sysinfo.cpu_pcnts[j][time][i];
-         h /= sysinfo.ncpu;
-      } else
-         for (i = 2; i < 4; i++) h += sysinfo.cpu_pcnts[cpu][time][i];
-      h = h * XINFO.height / 100;
-      XftDrawRect(XINFO.xftdraw, &COLOR3, x + col, XINFO.height - h, 1, h);
-
-      /* interrupt time */
-      if (cpu == -1) {
-         for (j = 0; j < sysinfo.ncpu; j++)
-            h = sysinfo.cpu_pcnts[j][time][3];
-         h /= sysinfo.ncpu;
-      } else
-         h = sysinfo.cpu_pcnts[cpu][time][3];
-      h = h * XINFO.height / 100;
-      XftDrawRect(XINFO.xftdraw, &COLOR5, x + col, XINFO.height - h, 1, h);
-      time = (time + 1) % sysinfo.hist_size;
-   }
+   if (first + n > size) {
+      memcpy(dst, src + first, (size - first) * sizeof(int));
+      memcpy(dst + size - first, src, (n - size + first) * sizeof(int));
+   } else
+      memcpy(dst, src + first, n * sizeof(int));
+}
+
+/*
+ * move the newest buckets of every tier of h, whose rings are oldsize
+ * long, into d's, which are newsize long: all of them if they fit.  they
+ * go to the start of d's rings, so the newest is at the last one moved.
+ */
+static void
+hist_move(hist_t *d, const hist_t *h, int newsize, int oldsize)
+{
+   const tier_t *t;
+   int k, kind, kinds, s, n;
 
-   x += sysinfo.hist_size + 1;
+   for (k = 0; k < HIST_TIERS; k++) {
+      t = &h->tiers[k];
+      n = (int)MIN((uint64_t)MIN(newsize, oldsize), t->buckets);
 
-   /* draw the text */
-   time = sysinfo.current;
-   for (state = 0; state < CPUSTATES; state++) {
-      if (cpu == -1) {
-         h = 0;
-         for (i = 0; i < sysinfo.ncpu; i++)
-            h += sysinfo.cpu_pcnts[i][time][state];
-         h /= sysinfo.ncpu;
-         snprintf(str, sizeof(str), "%3d%%%s", h, cpuStateNames[state]);
-      } else
-         snprintf(str, sizeof(str), "%3d%%%s",
-            sysinfo.cpu_pcnts[cpu][time][state], cpuStateNames[state]);
-
-      x += render_text(cpuStateColors[state], x, y, str);
+      kinds = (k == 0) ? 1 : 3;
+      for (kind = 0; kind < kinds && n > 0; kind++)
+         for (s = 0; s < h->nseries; s++)
+            ring_move(series_at(d, newsize, k, kind, s),
+               series_at(h, oldsize, k, kind, s), oldsize, t->current, n);
+
+      d->tiers[k] = *t;
+      d->tiers[k].current = (n - 1 + newsize) % newsize;
    }
 
-   return x - startx;
+   memcpy(d->sums, h->sums, (HIST_TIERS - 1) * h->nseries * sizeof(int64_t));
 }
 
-int
-mem_draw(XftColor *color, int x, int y)
+/*
+ * change the number of samples (and buckets of every tier) kept, for
+ * graphs that got wider or go back further, or less so.  what fits of
+ * the history is kept, the newest of it if it shrank, so the graphs carry
+ * on where they were.
+ */
+void
+sysinfo_resize(int hist_size)
 {
-   int h, total;
-   int startx;
-   int col, time, cur;
+   sysinfo_t old = sysinfo;
+   void  *copy;
+   bool   restored;
 
-   startx = x;
-   cur = sysinfo.current;
+   if (hist_size < 1 || hist_size == sysinfo.hist_size)
+      return;
 
-   /* determine total memory */
-   total = sysinfo.memory[cur][MEM_ACT]
-         + sysinfo.memory[cur][MEM_TOT]
-         + sysinfo.memory[cur][MEM_FRE];
+   /* a mapped block goes away with the file, which starts over */
+   if (history_mapped()) {
+      if ((copy = malloc(sysinfo.hist_bytes)) == NULL)
+         err(1, "sysinfo resize: history block copy failed");
+      memcpy(copy, sysinfo.hist_block, sysinfo.hist_bytes);
+      sysinfo_rebase(&old, &sysinfo, copy);
+      history_close();
+   }
 
-   /* start drawing ... */
-   x += render_text(color, x, y, "mem: ") + 1;
+   sysinfo_hist_alloc(hist_size, &restored);
+   memcpy(sysinfo.cpu_raw, old.cpu_raw,
+      2 * sysinfo.ncpu * CPUSTATES * sizeof(uint64_t));
+   hist_move(&sysinfo.cpu_hist, &old.cpu_hist, hist_size, old.hist_size);
+   hist_move(&sysinfo.mem_hist, &old.mem_hist, hist_size, old.hist_size);
+   sysinfo.current     = sysinfo.cpu_hist.tiers[0].current;
+   sysinfo.mem_current = sysinfo.mem_hist.tiers[0].current;
+   sysinfo.resizes++;
+
+   history_sync();
+   free(old.hist_block);
+}
 
-   /* green bg for graph */
-   XftDrawRect(XINFO.xftdraw, &COLOR2, x, 0, sysinfo.hist_size, XINFO.height);
+/* copy the n ring entries up to and including index last */
+static void
+ring_copy(int *dst, const int *src, int last, int n)
+{
+   int first = last - n + 1;
 
-   /* start drawing each bar in the bar-graph */
-   time = (sysinfo.current + 1) % sysinfo.hist_size;
-   for (col = 0; col < sysinfo.hist_size; col += 1) {
+   if (first < 0) {
+      first += sysinfo.hist_size;
+      memcpy(dst + first, src + first,
+         (sysinfo.hist_size - first) * sizeof(int));
+      first = 0;
+   }
+   memcpy(dst + first, src + first, (last - first + 1) * sizeof(int));
+}
 
-      if ((sysinfo.memory[time][MEM_ACT] != 0)
-      ||  (sysinfo.memory[time][MEM_TOT] != 0)
-      ||  (sysinfo.memory[time][MEM_FRE] != 0)) {
+/*
+ * bring d, a copy of h from before, up to date: only the buckets of each
+ * tier that were added since, and the one that was newest then.  false if
+ * that is more than the ring holds (or h went back), so it all has to be.
+ */
+static bool
+hist_sync(hist_t *d, const hist_t *h)
+{
+   uint64_t n;
+   int k, kind, kinds, s;
+
+   for (k = 0; k < HIST_TIERS; k++) {
+      if (h->tiers[k].buckets < d->tiers[k].buckets)
+         return false;
+      n = h->tiers[k].buckets - d->tiers[k].buckets + 1;
+      if (n > (uint64_t)sysinfo.hist_size)
+         return false;
+
+      kinds = (k == 0) ? 1 : 3;
+      for (kind = 0; kind < kinds; kind++)
+         for (s = 0; s < h->nseries; s++)
+            ring_copy(hist_series(d, k, kind, s), hist_series(h, k, kind, s),
+               h->tiers[k].current, n);
+   }
 
+   memcpy(d->sums, h->sums, (HIST_TIERS - 1) * h->nseries * sizeof(int64_t));
+   memcpy(d->tiers, h->tiers, HIST_TIERS * sizeof(tier_t));
+   return true;
+}
 
-        /* draw yellow (total) bar */
-        h = (sysinfo.memory[time][MEM_TOT] + sysinfo.memory[time][MEM_ACT])
-          * XINFO.height / total;
+/*
+ * copy all of src into dst, history included.  dst keeps its own history
+ * block, which is only reallocated if the size of src's changed.
+ */
+static void
+sysinfo_copy(sysinfo_t *dst, const sysinfo_t *src)
+{
+   void  *block = dst->hist_block;
 
-        XftDrawRect(XINFO.xftdraw, &COLOR3, x + col, XINFO.height - h, 1, h);
+   if (block == NULL || dst->hist_bytes != src->hist_bytes) {
+      free(block);
+      if (posix_memalign(&block, CACHELINE, src->hist_bytes))
+         err(1, "sysinfo copy: history block allocation failed");
+   }
 
-        /* draw red (active) bar */
-        h = sysinfo.memory[time][MEM_ACT] * XINFO.height / total;
-        XftDrawRect(XINFO.xftdraw, &COLOR1, x + col, XINFO.height - h, 1, h);
-      }
+   memcpy(block, src->hist_block, src->hist_bytes);
+   sysinfo_rebase(dst, src, block);
+}
 
-      time = (time + 1) % sysinfo.hist_size;
-   }
-   x += sysinfo.hist_size + 1;
-
-   /* draw numbers */
-   x += render_text(&COLOR1, x, y, fmtmem(sysinfo.memory[cur][MEM_ACT]));
-   x += render_text(color, x, y, "/");
-   x += render_text(&COLOR3, x, y, fmtmem(sysinfo.memory[cur][MEM_TOT]));
-   x += render_text(color, x, y, "/");
-   x += render_text(&COLOR2, x, y, fmtmem(sysinfo.memory[cur][MEM_FRE]));
-
-   /* draw swap, if any is used */
-   if (sysinfo.swap_used > 0) {
-      x += render_text(color, x, y, " swap:");
-      x += render_text(&COLOR1, x, y, fmtmem(sysinfo.swap_used));
-      x += render_text(color, x, y, "/");
-      x += render_text(&COLOR2, x, y, fmtmem(sysinfo.swap_total));
+/*
+ * like sysinfo_copy(), for a dst that is a copy of src from before: of the
+ * history, only what changed since is copied (with the sampler's tiers,
+ * all of it is megabytes).  must run on src's thread, for hist_size.
+ */
+void
+sysinfo_sync(sysinfo_t *dst, const sysinfo_t *src)
+{
+   sysinfo_t old = *dst;
+
+   if (dst->hist_block == NULL || dst->hist_bytes != src->hist_bytes
+   ||  dst->hist_size != src->hist_size || dst->ncpu != src->ncpu
+   ||  dst->resizes != src->resizes) {
+      sysinfo_copy(dst, src);
+      return;
    }
 
-   return x - startx;
+   sysinfo_rebase(dst, src, old.hist_block);
+   memcpy(dst->cpu_raw, src->cpu_raw,
+      2 * src->ncpu * CPUSTATES * sizeof(uint64_t));
+   if (!hist_sync(&dst->cpu_hist, &src->cpu_hist)
+   ||  !hist_sync(&dst->mem_hist, &src->mem_hist))
+      sysinfo_copy(dst, src);
 }
 
-int
-procs_draw(XftColor *color, int x, int y)
+/* the cpu graphs (and numbers) change with every sample */
+unsigned long
+cpu_hash(int cpu)
 {
-   static char str[1000];
-   int startx;
-
-   startx = x;
-   x += render_text(color, x, y, "procs: ");
+   return hash_mix(hash_mix(HASH_INIT, cpu), sysinfo.samples);
+}
 
-   /* FIXME finish getting the number of active processes
-    * i, personally, like this...
-   snprintf(str, sizeof(str), "%d", sysinfo.procs_active);
-   x += render_text(COLOR1, x, y, str);
+unsigned long
+cpu_heatmap_hash(int width)
+{
+   return hash_mix(cpu_hash(-2), width);
+}
 
-   x += render_text(color, x, y, "/");
-   */
+unsigned long
+mem_hash()
+{
+   unsigned long h = HASH_INIT;
 
-   snprintf(str, sizeof(str), "%d", sysinfo.procs_total);
-   x += render_text(&COLOR1, x, y, str);
+   h = hash_mix(h, sysinfo.mem_samples);
+   h = hash_mix(h, sysinfo.swap_used);
+   h = hash_mix(h, sysinfo.swap_total);
+   return h;
+}
 
-   return x - startx;
+unsigned long
+procs_hash()
+{
+   return hash_mix(HASH_INIT, sysinfo.procs_total);
 }
 
 
@@ -685,18 +645,72 @@ procs_draw(XftColor *color, int x, int y)
  * time
  ****************************************************************************/
 
+/*
+ * the finest unit, in milliseconds, that fmt shows of the time: the clock
+ * only needs re-formatting when that rolls over.  conversions not known
+ * here are taken to show seconds.
+ */
 int
-time_draw(XftColor *color, int x, int y)
+time_granularity(const char *fmt)
 {
-   static char timestr[1000];
+   int unit = 24 * 60 * 60 * 1000;
+   const char *p;
+
+   for (p = strchr(fmt, '%'); p != NULL; p = strchr(p + 1, '%')) {
+      p++;
+      while (*p == 'E' || *p == 'O')
+         p++;
+
+      switch (*p) {
+         case '%': case 'n': case 't':
+            break;
+         /* the date */
+         case 'a': case 'A': case 'b': case 'B': case 'C': case 'd':
+         case 'D': case 'e': case 'F': case 'g': case 'G': case 'h':
+         case 'j': case 'm': case 'u': case 'U': case 'V': case 'w':
+         case 'W': case 'x': case 'y': case 'Y': case 'z': case 'Z':
+            break;
+         /* the hour */
+         case 'H': case 'I': case 'k': case 'l': case 'p':
+            unit = MIN(unit, 60 * 60 * 1000);
+            break;
+         /* the minute */
+         case 'M': case 'R':
+            unit = MIN(unit, 60 * 1000);
+            break;
+         case '\0':    /* a stray % at the end */
+            return unit;
+         default:
+            unit = MIN(unit, 1000);
+            break;
+      }
+   }
+
+   return unit;
+}
+
+bool
+time_update()
+{
+   static char newstr[sizeof(timeinfo.str)];
+   struct tm tm;
    time_t now = time(NULL);
 
-   /* first build the string */
-   strftime(timestr, sizeof(timestr), time_fmt, localtime(&now));
+   strftime(newstr, sizeof(newstr), time_fmt, localtime_r(&now, &tm));
+   if (strcmp(newstr, timeinfo.str) == 0)
+      return false;
 
-   /* XXX hack to right-align it - rethink a more general way for this */
-   XGlyphInfo extents;
-   XftTextExtents8(XINFO.disp, XINFO.font, (XftChar8 *)timestr, strlen(timestr), &extents );
-   return render_text(color, XINFO.width - extents.width, y, timestr);
+   strlcpy(timeinfo.str, newstr, sizeof(timeinfo.str));
+   return true;
 }
 
+unsigned long
+time_hash()
+{
+   unsigned long h = HASH_INIT;
+   char *c;
+
+   for (c = timeinfo.str; *c != '\0'; c++)
+      h = hash_mix(h, (unsigned char)*c);
+   return h;
+}
@@ -27,44 +27,87 @@
 #include <math.h>
 #include <err.h>
 
-#include <machine/apmvar.h>
-#include <sys/audioio.h>
-#include <sys/vmmeter.h>
-#include <sys/ioctl.h>
 #include <sys/param.h>
-#include <sys/sched.h>
-#include <sys/sysctl.h>
 #include <sys/types.h>
-#include <sys/swap.h>
 
-#include "xstatbar.h"
+#ifdef __OpenBSD__
+#include <sys/sched.h>     /* CPUSTATES */
+#else
+/* the cpu states, in the order OpenBSD's <sys/sched.h> has them */
+#define CP_USER   0
+#define CP_NICE   1
+#define CP_SYS    2
+#define CP_INTR   3
+#define CP_IDLE   4
+#define CPUSTATES 5
+#endif
 
 /*
  * The following are all global structs used to record the various stats
  * queried by xstatbar.
+ *
+ * They are per-thread: the sampler thread (see sampler.c) runs the
+ * *_update()s against its own copies and publishes them, and the main
+ * thread draws from its copies, which sampler_read() refreshes.  So the
+ * same code reads and writes them on either side without any locking.
  */
 
 /* volume */
 typedef struct {
    bool  is_setup;
 
-   int   dev_fd;
-   int   master_idx;
-
    int   max;
    int   nchan;
    int   left;
    int   right;
+   bool  muted;
 } volume_info_t;
-extern volume_info_t volume;
+extern __thread volume_info_t volume;
 
 /* power */
 typedef struct {
    bool   is_setup;
-   int    dev_fd;
-   struct apm_power_info   info;
+
+#define AC_UNKNOWN 0
+#define AC_OFF     1
+#define AC_ON      2
+   int    ac_state;
+   int    battery_life;   /* in percent */
+   int    minutes_left;   /* on battery, -1 if unknown */
 } power_info_t;
-extern power_info_t power;
+extern __thread power_info_t power;
+
+/*
+ * The history of a set of series (the cpus', or memory's) is kept in
+ * tiers: the samples themselves, then buckets of 10, 60, 600 and 3600
+ * samples, hist_size of each.  A bucket keeps the min, max and mean of
+ * every series over its samples, and is rolled up as they arrive (see
+ * hist_add()), so a graph of a long time draws from a coarser tier for
+ * what one of a short time costs.  The tiers' cursors live in the history
+ * block along with the data.
+ */
+#define HIST_TIERS   5
+#define HIST_FACTORS { 1, 10, 60, 600, 3600 }
+
+#define TIER_MIN  0
+#define TIER_MAX  1
+#define TIER_MEAN 2
+
+typedef struct {
+   int32_t   factor;     /* samples per bucket */
+   int32_t   current;    /* ring index of the newest bucket */
+   int32_t   fill;       /* samples in it so far */
+   int32_t   pad;
+   uint64_t  buckets;    /* buckets begun so far */
+} tier_t;
+
+typedef struct {
+   int        nseries;
+   tier_t    *tiers;     /* [HIST_TIERS]; the first is the samples */
+   int       *raw;       /* [nseries][hist_size], the samples */
+   int       *rollup;    /* [HIST_TIERS - 1][3][nseries][hist_size] */
+   int64_t   *sums;      /* [HIST_TIERS - 1][nseries], of the newest buckets */
+} hist_t;
 
 /* system info (cpu + memory + proccess info) */
 typedef struct {
@@ -76,21 +119,63 @@ typedef struct {
 
    int       swap_used;    /* swap space used */
    int       swap_total;   /* total amount of swap space */
+   int       mem_physical; /* physical memory, the scale of the memory graph */
 
    /* cpu/memory historical stuff (for graphs) */
 
-   int    hist_size;       /* size of graphs/historical-arrays */
+   int    hist_size;       /* samples (buckets) kept of each tier */
+   unsigned long resizes;  /* times hist_size changed (see sysinfo_resize()) */
    int    current;         /* "current" spot in historical arrays */
+   unsigned long samples;  /* # of samples taken so far */
+
+   /* memory is sampled separately from the cpus, so has its own cursor */
+   int    mem_current;
+   unsigned long mem_samples;
 
-   /* historical data (for graphs) */
+   /*
+    * historical data (for graphs).  all of it lives in one cache-line
+    * aligned block laid out as a struct-of-arrays: each series below is a
+    * contiguous run of hist_size ints, so a graph walks it linearly.  the
+    * raw tick counters only ever need the last two samples.
+    */
 #define MEM_ACT 0
 #define MEM_TOT 1
 #define MEM_FRE 2
-   int        **memory;    /* [hist_size][3] */
-   int      ***cpu_pcnts;  /* [ncpu][hist_size][CPUSTATES] */
-   uint64_t ***cpu_raw;    /* [ncpu][hist_size][CPUSTATES] */
+   void      *hist_block;  /* the one allocation (or mapping, see history.h) */
+   size_t     hist_bytes;  /* and its size */
+   int        raw_slot;    /* which cpu_raw slot holds the newest ticks */
+   int       *memory;      /* [3][hist_size] */
+   int       *cpu_pcnts;   /* [1 + ncpu][CPUSTATES][hist_size], all cpus first */
+   uint64_t  *cpu_raw;     /* [2][ncpu][CPUSTATES] */
+
+   /* the same series, with their tiers */
+   hist_t     cpu_hist;    /* series (1 + cpu) * CPUSTATES + state */
+   hist_t     mem_hist;    /* series MEM_ACT, MEM_TOT and MEM_FRE */
 } sysinfo_t;
-extern sysinfo_t sysinfo;
+extern __thread sysinfo_t sysinfo;
+
+/*
+ * accessors for the series in the history block.  cpu -1 is the average
+ * of the cpus online, which is kept up to date as the cpus are sampled.
+ */
+#define MEM_HIST(k) \
+   (sysinfo.memory + (k) * sysinfo.hist_size)
+#define CPU_HIST(cpu, state) \
+   (sysinfo.cpu_pcnts + (((cpu) + 1) * CPUSTATES + (state)) * sysinfo.hist_size)
+#define CPU_RAW(slot, cpu) \
+   (sysinfo.cpu_raw + ((slot) * sysinfo.ncpu + (cpu)) * CPUSTATES)
+
+/* a series of a tier, for one of TIER_MIN/MAX/MEAN (all the same in tier 0) */
+int  *hist_series(const hist_t *h, int tier, int kind, int series);
+
+/* the history size graphs of width pixels need to go back window samples */
+int   hist_size_for(int width, int window);
+
+/* time */
+typedef struct {
+   char  str[256];        /* as formatted by strftime(3) */
+} time_info_t;
+extern __thread time_info_t timeinfo;
 
 /* brightness - FIXME still working on this part */
 typedef struct {
@@ -101,40 +186,93 @@ extern brightness_info_t brightness;
 /* the format used by strftime(3) */
 extern char *time_fmt;
 
+/* system calls made by the *_update()s so far (see profile.c) */
+extern unsigned long stat_syscalls;
+
 
 /*
  * The following are used to initialize, update, and end the querying of
- * the above stats.
+ * the above stats.  Everything but sysinfo_init/resize/update/close/sync is
+ * implemented per platform, in stats_openbsd.c or stats_linux.c.
  */
 
-/* volume */
+/*
+ * Each *_update() returns true if it produced anything new to display.
+ */
+
+/*
+ * volume.  volume_fd() is a descriptor that becomes readable when the
+ * mixer changed, or -1 if it has to be polled; volume_update() reads the
+ * changes.
+ */
 void volume_init();
-void volume_update();
+int  volume_fd();
+bool volume_update();
 void volume_close();
 
-/* power */
+/*
+ * power.  power_fd() is like volume_fd(), for AC being plugged in or out;
+ * the battery level is polled either way.  power_event() is the update
+ * for when power_fd() is readable, which needn't read anything if what
+ * it says isn't about power.
+ */
 void power_init();
-void power_update();
+int  power_fd();
+bool power_update();
+bool power_event();
 void power_close();
 
 /* sysinfo (includes cpu/memory/process information) */
 void sysinfo_init(int hist_size);
+void sysinfo_resize(int hist_size);
 void sysinfo_update();
 void sysinfo_close();
+void sysinfo_sync(sysinfo_t *dst, const sysinfo_t *src);
+void sysinfo_sys_init();    /* sets ncpu (and pageshift) */
+void sysinfo_sys_close();
+
+/* the parts of sysinfo, which can be sampled at their own rates */
+bool cpu_update();
+bool mem_update();
+bool swap_update();
+bool procs_update();
+
+/*
+ * used by the platform cpu_update()s around reading the raw ticks, and
+ * mem_update()s around filling in a memory sample
+ */
+int  cpu_sample_begin();
+void cpu_sample_end();
+int  mem_sample_begin();
+void mem_sample_end();
+
+/*
+ * roll the sample at ring index cur up into the tiers, or move them on
+ * past samples that were missed
+ */
+void hist_add(hist_t *h, int cur, unsigned long samples);
+void hist_skip(hist_t *h, unsigned long n);
+
+/* time (formats the time string, which changes every time_granularity ms) */
+int  time_granularity(const char *fmt);
+bool time_update();
 
 
 /*
- * The following are used to draw the stats.  Each takes a color that is
- * used for coloring the TEXT and the text only.  Additionally, they take
- * an (x,y) for where to start drawing their stats.  They each return
- * the width, in pixels, of what they drew.
+ * The following hash the state each of the stats above would show, so
+ * that a widget whose hash did not change since it was last drawn (see
+ * render.h) or written out (see stream.h) can be skipped.
  */
 
-int  volume_draw(XftColor *c, int x, int y);
-int  power_draw(XftColor *c, int x, int y);
-int  cpu_draw(int cpu, XftColor *c, int x, int y);
-int  mem_draw(XftColor *c, int x, int y);
-int  procs_draw(XftColor *c, int x, int y);
-int  time_draw(XftColor *c, int x, int y);
+unsigned long  volume_hash();
+unsigned long  power_hash();
+unsigned long  cpu_hash(int cpu);
+unsigned long  cpu_heatmap_hash(int width);
+unsigned long  mem_hash();
+unsigned long  procs_hash();
+unsigned long  time_hash();
+
+/* memory (in kilobytes) as shown, such as "512M"; in a static buffer */
+char          *fmtmem(int m);
 
 #endif
@@ -0,0 +1,739 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Linux collectors.  Everything but the volume comes from /proc and /sys,
+ * through file descriptors opened once and re-read with pread(2) into
+ * fixed buffers, and is parsed by hand (no stdio) in a single pass per
+ * file.  The volume comes from ALSA's mixer.
+ */
+
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <alsa/asoundlib.h>
+
+#include "stats.h"
+#include "profile.h"
+
+/* a /proc file, kept open */
+typedef struct {
+   const char *name;
+   int         fd;
+   char       *buf;
+   size_t      size;
+   char        path[PATH_MAX];
+} procfile_t;
+
+static procfile_t proc_stat    = { "stat",    -1, NULL, 0 };
+static procfile_t proc_meminfo = { "meminfo", -1, NULL, 4096 };
+static procfile_t proc_swaps   = { "swaps",   -1, NULL, 4096 };
+static procfile_t proc_loadavg = { "loadavg", -1, NULL, 128 };
+
+/*
+ * where procfs is: /proc, or wherever $XSTATBAR_PROCFS says, for trying
+ * this on a fake tree (see xstatbar-bench -p)
+ */
+static const char *
+procfs()
+{
+   const char *root;
+
+   if ((root = getenv("XSTATBAR_PROCFS")) == NULL)
+      root = "/proc";
+   return root;
+}
+
+static void
+proc_open(procfile_t *f)
+{
+   snprintf(f->path, sizeof(f->path), "%s/%s", procfs(), f->name);
+   if ((f->fd = open(f->path, O_RDONLY | O_CLOEXEC)) == -1)
+      err(1, "sysinfo init: failed to open %s", f->path);
+   if ((f->buf = malloc(f->size)) == NULL)
+      err(1, "sysinfo init: %s buffer malloc failed", f->path);
+}
+
+static void
+proc_close(procfile_t *f)
+{
+   if (f->fd != -1)
+      close(f->fd);
+   free(f->buf);
+   f->fd = -1;
+   f->buf = NULL;
+}
+
+/*
+ * re-read a file from the start.  the result is NUL-terminated; anything
+ * past the end of the buffer is simply not seen.
+ */
+static char *
+proc_read(procfile_t *f)
+{
+   ssize_t n;
+
+   PROFILE_ADD(stat_syscalls, 1);
+   while ((n = pread(f->fd, f->buf, f->size - 1, 0)) == -1) {
+      if (errno != EINTR)
+         err(1, "sysinfo update: failed to read %s", f->path);
+   }
+
+   f->buf[n] = '\0';
+   return f->buf;
+}
+
+/* parse an unsigned integer at p (after any blanks), returning its end */
+static char *
+scan_u64(char *p, uint64_t *v)
+{
+   uint64_t n = 0;
+
+   while (*p == ' ' || *p == '\t')
+      p++;
+   while (*p >= '0' && *p <= '9')
+      n = n * 10 + (*p++ - '0');
+
+   *v = n;
+   return p;
+}
+
+/* skip a blank-separated field */
+static char *
+skip_field(char *p)
+{
+   while (*p == ' ' || *p == '\t')
+      p++;
+   while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\n')
+      p++;
+   return p;
+}
+
+static char *
+next_line(char *p)
+{
+   while (*p != '\0' && *p != '\n')
+      p++;
+   return (*p == '\n') ? p + 1 : p;
+}
+
+
+/*****************************************************************************
+ * volume stuff
+ ****************************************************************************/
+
+/*
+ * the "Master" control of ALSA's default mixer.  the mixer's descriptor
+ * becomes readable when any of its controls change, so there's no need
+ * to poll it.
+ */
+static snd_mixer_t      *mixer = NULL;
+static snd_mixer_elem_t *master = NULL;
+static long              master_min;
+
+/* read the master control's volume and mute switch */
+static void
+volume_read()
+{
+   long left, right;
+   int  on;
+
+   snd_mixer_selem_get_playback_volume(master, SND_MIXER_SCHN_FRONT_LEFT, &left);
+   if (volume.nchan == 1)
+      right = left;
+   else
+      snd_mixer_selem_get_playback_volume(master, SND_MIXER_SCHN_FRONT_RIGHT,
+         &right);
+   volume.left  = left - master_min;
+   volume.right = right - master_min;
+
+   if (snd_mixer_selem_has_playback_switch(master)) {
+      snd_mixer_selem_get_playback_switch(master, SND_MIXER_SCHN_FRONT_LEFT, &on);
+      volume.muted = !on;
+   }
+}
+
+void
+volume_init()
+{
+   snd_mixer_elem_t *elem;
+   long max;
+   int  e;
+
+   volume.is_setup = false;
+
+   if ((e = snd_mixer_open(&mixer, 0)) < 0) {
+      warnx("volume: failed to open the mixer: %s", snd_strerror(e));
+      mixer = NULL;
+      return;
+   }
+
+   if ((e = snd_mixer_attach(mixer, "default")) < 0
+   ||  (e = snd_mixer_selem_register(mixer, NULL, NULL)) < 0
+   ||  (e = snd_mixer_load(mixer)) < 0) {
+      warnx("volume: failed to load the mixer: %s", snd_strerror(e));
+      volume_close();
+      return;
+   }
+
+   for (elem = snd_mixer_first_elem(mixer); elem != NULL;
+        elem = snd_mixer_elem_next(elem)) {
+      if (strcmp(snd_mixer_selem_get_name(elem), "Master") == 0
+      &&  snd_mixer_selem_has_playback_volume(elem)) {
+         master = elem;
+         break;
+      }
+   }
+
+   if (master == NULL) {
+      warnx("volume: failed to find the \"Master\" mixer control");
+      volume_close();
+      return;
+   }
+
+   snd_mixer_selem_get_playback_volume_range(master, &master_min, &max);
+   volume.max = max - master_min;
+   volume.nchan = snd_mixer_selem_is_playback_mono(master) ? 1 : 2;
+   volume_read();
+
+   volume.is_setup = true;
+}
+
+int
+volume_fd()
+{
+   struct pollfd pfd;
+
+   if (!volume.is_setup || snd_mixer_poll_descriptors(mixer, &pfd, 1) < 1)
+      return -1;
+
+   return pfd.fd;
+}
+
+/* handle whatever the mixer has to tell us, then read the master control */
+bool
+volume_update()
+{
+   volume_info_t old = volume;
+
+   if (!volume.is_setup)
+      return false;
+
+   PROFILE_ADD(stat_syscalls, 1);
+   if (snd_mixer_handle_events(mixer) < 0) {
+      warnx("volume: lost the mixer");
+      volume_close();
+      return true;
+   }
+   volume_read();
+
+   return volume.left != old.left || volume.right != old.right
+       || volume.muted != old.muted;
+}
+
+void
+volume_close()
+{
+   if (mixer != NULL)
+      snd_mixer_close(mixer);
+   mixer = NULL;
+   master = NULL;
+   volume.is_setup = false;
+}
+
+
+/*****************************************************************************
+ * power stuff
+ ****************************************************************************/
+
+/*
+ * the power supplies under /sys/class/power_supply (or wherever
+ * $XSTATBAR_SYSFS says sysfs is, for trying this on a fake tree).  each
+ * attribute that is read is kept open.  the kernel announces AC being
+ * plugged in or out as a uevent, so those are listened for on a netlink
+ * socket; the battery is polled on the widget's period.
+ */
+#define MAX_SUPPLIES 4
+
+typedef struct {
+   int   capacity;      /* percent */
+   int   status;        /* "Charging", "Discharging", "Full", ... */
+   int   now;           /* energy_now (uWh) or charge_now (uAh) */
+   int   rate;          /* power_now (uW) or current_now (uA), to match */
+} battery_t;
+
+static int       ac_online[MAX_SUPPLIES];
+static int       nac = 0;
+static battery_t batteries[MAX_SUPPLIES];
+static int       nbat = 0;
+static int       uevent_fd = -1;
+
+/* open a supply's attribute, -1 if it doesn't have it */
+static int
+supply_open(const char *dir, const char *attr)
+{
+   char path[PATH_MAX];
+
+   snprintf(path, sizeof(path), "%s/%s", dir, attr);
+   return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+/* re-read an attribute, without its newline.  false if it can't be read */
+static bool
+supply_read(int fd, char *buf, size_t size)
+{
+   ssize_t n;
+
+   if (fd == -1)
+      return false;
+
+   PROFILE_ADD(stat_syscalls, 1);
+   if ((n = pread(fd, buf, size - 1, 0)) <= 0)
+      return false;
+
+   buf[n] = '\0';
+   buf[strcspn(buf, "\n")] = '\0';
+   return true;
+}
+
+/* re-read a numeric attribute, -1 if it can't be */
+static long long
+supply_value(int fd)
+{
+   char buf[32];
+   uint64_t v;
+
+   if (!supply_read(fd, buf, sizeof(buf)) || buf[0] < '0' || buf[0] > '9')
+      return -1;
+
+   scan_u64(buf, &v);
+   return v;
+}
+
+/* add the supply in dir, if it is AC or a battery */
+static void
+supply_add(const char *dir)
+{
+   battery_t *b;
+   char type[32];
+   int  fd;
+
+   if ((fd = supply_open(dir, "type")) == -1)
+      return;
+   if (!supply_read(fd, type, sizeof(type)))
+      type[0] = '\0';
+   close(fd);
+
+   if (strcmp(type, "Mains") == 0 && nac < MAX_SUPPLIES) {
+      if ((ac_online[nac] = supply_open(dir, "online")) != -1)
+         nac++;
+   } else if (strcmp(type, "Battery") == 0 && nbat < MAX_SUPPLIES) {
+      b = &batteries[nbat];
+      if ((b->capacity = supply_open(dir, "capacity")) == -1)
+         return;
+      b->status = supply_open(dir, "status");
+      if ((b->now = supply_open(dir, "energy_now")) != -1)
+         b->rate = supply_open(dir, "power_now");
+      else if ((b->now = supply_open(dir, "charge_now")) != -1)
+         b->rate = supply_open(dir, "current_now");
+      else
+         b->rate = -1;
+      nbat++;
+   }
+}
+
+/* listen for the kernel's uevents */
+static void
+uevent_open()
+{
+   struct sockaddr_nl sa;
+
+   uevent_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+      NETLINK_KOBJECT_UEVENT);
+   if (uevent_fd == -1) {
+      warn("power: no uevents, AC changes are only polled");
+      return;
+   }
+
+   memset(&sa, 0, sizeof(sa));
+   sa.nl_family = AF_NETLINK;
+   sa.nl_groups = 1;    /* the kernel's own */
+   if (bind(uevent_fd, (struct sockaddr *)&sa, sizeof(sa)) == -1) {
+      warn("power: no uevents, AC changes are only polled");
+      close(uevent_fd);
+      uevent_fd = -1;
+   }
+}
+
+/*
+ * drain the pending uevents.  returns true if any were about a power
+ * supply.  each uevent is a run of NUL-terminated "KEY=value" strings.
+ */
+static bool
+uevent_drain()
+{
+   static char msg[8192];
+   bool supply = false;
+   ssize_t n;
+   char *p;
+
+   if (uevent_fd == -1)
+      return false;
+
+   while ((n = recv(uevent_fd, msg, sizeof(msg) - 1, 0)) > 0) {
+      PROFILE_ADD(stat_syscalls, 1);
+      msg[n] = '\0';
+      for (p = msg; p < msg + n; p += strlen(p) + 1) {
+         if (strcmp(p, "SUBSYSTEM=power_supply") == 0)
+            supply = true;
+      }
+   }
+   PROFILE_ADD(stat_syscalls, 1);
+
+   return supply;
+}
+
+void
+power_init()
+{
+   const char *root;
+   char  path[PATH_MAX];
+   struct dirent *d;
+   DIR  *dir;
+
+   power.is_setup = false;
+
+   if ((root = getenv("XSTATBAR_SYSFS")) == NULL)
+      root = "/sys";
+   snprintf(path, sizeof(path), "%s/class/power_supply", root);
+   if ((dir = opendir(path)) == NULL) {
+      warn("power: failed to open %s", path);
+      return;
+   }
+
+   while ((d = readdir(dir)) != NULL) {
+      if (d->d_name[0] == '.')
+         continue;
+      snprintf(path, sizeof(path), "%s/class/power_supply/%s", root,
+         d->d_name);
+      supply_add(path);
+   }
+   closedir(dir);
+
+   /* no battery, nothing worth showing */
+   if (nbat == 0) {
+      power_close();
+      return;
+   }
+
+   uevent_open();
+   power.is_setup = true;
+}
+
+int
+power_fd()
+{
+   return power.is_setup ? uevent_fd : -1;
+}
+
+/* read all the supplies */
+static bool
+power_read()
+{
+   power_info_t old = power;
+   long long v, life, now, rate;
+   char status[32];
+   bool draining;
+   int  i, n;
+
+   /* on AC if any charger says so; without any, go by the batteries */
+   power.ac_state = (nac > 0) ? AC_OFF : AC_UNKNOWN;
+   for (i = 0; i < nac; i++) {
+      if (supply_value(ac_online[i]) == 1)
+         power.ac_state = AC_ON;
+   }
+
+   life = now = rate = 0;
+   draining = false;
+   for (i = n = 0; i < nbat; i++) {
+      if ((v = supply_value(batteries[i].capacity)) == -1)
+         continue;
+      life += v;
+      n++;
+
+      if (supply_read(batteries[i].status, status, sizeof(status))
+      &&  strcmp(status, "Discharging") == 0)
+         draining = true;
+      if ((v = supply_value(batteries[i].now)) > 0)
+         now += v;
+      if ((v = supply_value(batteries[i].rate)) > 0)
+         rate += v;
+   }
+   if (power.ac_state == AC_UNKNOWN)
+      power.ac_state = draining ? AC_OFF : AC_ON;
+
+   power.battery_life = (n > 0) ? life / n : 0;
+
+   /* only an estimate while draining: charging or full has no end */
+   if (power.ac_state == AC_OFF && rate > 0)
+      power.minutes_left = now * 60 / rate;
+   else
+      power.minutes_left = -1;
+
+   return power.ac_state != old.ac_state
+       || power.battery_life != old.battery_life
+       || power.minutes_left != old.minutes_left;
+}
+
+/*
+ * on the widget's period: whatever the uevents say, the battery level is
+ * read.  they are drained all the same, so a pending one about a supply
+ * doesn't have power_event() read it all again right after.
+ */
+bool
+power_update()
+{
+   if (!power.is_setup)
+      return false;
+
+   uevent_drain();
+   return power_read();
+}
+
+/* on uevents: only those about a power supply are worth reading it for */
+bool
+power_event()
+{
+   if (!power.is_setup || !uevent_drain())
+      return false;
+
+   return power_read();
+}
+
+void
+power_close()
+{
+   int i;
+
+   for (i = 0; i < nac; i++)
+      close(ac_online[i]);
+   for (i = 0; i < nbat; i++) {
+      close(batteries[i].capacity);
+      if (batteries[i].status != -1)
+         close(batteries[i].status);
+      if (batteries[i].now != -1)
+         close(batteries[i].now);
+      if (batteries[i].rate != -1)
+         close(batteries[i].rate);
+   }
+   nac = nbat = 0;
+
+   if (uevent_fd != -1)
+      close(uevent_fd);
+   uevent_fd = -1;
+}
+
+
+/*****************************************************************************
+ * sysinf stuff (cpu/mem/procs)
+ ****************************************************************************/
+
+/* the cpus a /proc/stat lists: one past the highest "cpuN" */
+static long
+stat_ncpu()
+{
+   procfile_t f = { "stat", -1, NULL, 1 << 20 };
+   uint64_t cpu;
+   long  ncpu;
+   char *p;
+
+   proc_open(&f);
+   ncpu = 0;
+   p = next_line(proc_read(&f));
+   for (; p[0] == 'c' && p[1] == 'p' && p[2] == 'u'; p = next_line(p)) {
+      scan_u64(p + 3, &cpu);
+      ncpu = MAX(ncpu, (long)cpu + 1);
+   }
+   proc_close(&f);
+
+   if (ncpu < 1)
+      errx(1, "sysinfo init: no cpus in %s", f.path);
+   return ncpu;
+}
+
+void
+sysinfo_sys_init()
+{
+   long ncpu;
+
+   /*
+    * cpus that are offline now are still counted, they may come back.  a
+    * fake /proc has the cpus it lists, however many this machine has.
+    */
+   if (getenv("XSTATBAR_PROCFS") != NULL)
+      ncpu = stat_ncpu();
+   else if ((ncpu = sysconf(_SC_NPROCESSORS_CONF)) < 1)
+      err(1, "sysinfo init: sysconf(_SC_NPROCESSORS_CONF) failed");
+   sysinfo.ncpu = ncpu;
+   sysinfo.pageshift = 0;
+
+   /* room for every "cpuN" line of /proc/stat, at most ~220 bytes each */
+   proc_stat.size = (sysinfo.ncpu + 1) * 256 + 1;
+
+   proc_open(&proc_stat);
+   proc_open(&proc_meminfo);
+   proc_open(&proc_swaps);
+   proc_open(&proc_loadavg);
+}
+
+void
+sysinfo_sys_close()
+{
+   proc_close(&proc_stat);
+   proc_close(&proc_meminfo);
+   proc_close(&proc_swaps);
+   proc_close(&proc_loadavg);
+}
+
+/* number of running/total processes (threads, really), from loadavg */
+bool
+procs_update()
+{
+   uint64_t running, total;
+   char *p;
+   int   old_active = sysinfo.procs_active;
+   int   old_total = sysinfo.procs_total;
+
+   /* "0.00 0.01 0.05 1/123 4567" */
+   p = proc_read(&proc_loadavg);
+   p = skip_field(skip_field(skip_field(p)));
+   p = scan_u64(p, &running);
+   if (*p == '/')
+      p++;
+   scan_u64(p, &total);
+
+   sysinfo.procs_active = running;
+   sysinfo.procs_total  = total;
+   return sysinfo.procs_active != old_active || sysinfo.procs_total != old_total;
+}
+
+/* memory history, from meminfo (all in kilobytes already) */
+enum { MI_TOTAL, MI_FREE, MI_AVAIL, MI_BUFFERS, MI_CACHED, MI_ACTIVE, NMEMINFO };
+static const char *meminfo_keys[NMEMINFO] = {
+   "MemTotal:", "MemFree:", "MemAvailable:", "Buffers:", "Cached:", "Active:"
+};
+
+bool
+mem_update()
+{
+   uint64_t val[NMEMINFO] = { 0 };
+   unsigned found = 0;
+   size_t   len;
+   char    *p;
+   int      cur, k;
+
+   p = proc_read(&proc_meminfo);
+   for (; *p != '\0' && found != (1U << NMEMINFO) - 1; p = next_line(p)) {
+      for (k = 0; k < NMEMINFO; k++) {
+         len = strlen(meminfo_keys[k]);
+         if (strncmp(p, meminfo_keys[k], len) == 0) {
+            scan_u64(p + len, &val[k]);
+            found |= 1U << k;
+            break;
+         }
+      }
+   }
+
+   /* old kernels have no MemAvailable */
+   if (!(found & (1U << MI_AVAIL)))
+      val[MI_AVAIL] = val[MI_FREE] + val[MI_BUFFERS] + val[MI_CACHED];
+
+   sysinfo.mem_physical = val[MI_TOTAL];
+   cur = mem_sample_begin();
+
+   MEM_HIST(MEM_ACT)[cur] = val[MI_ACTIVE];
+   MEM_HIST(MEM_TOT)[cur] = val[MI_TOTAL] - val[MI_AVAIL];
+   MEM_HIST(MEM_FRE)[cur] = val[MI_FREE];
+   mem_sample_end();
+   return true;
+}
+
+/* swap status, summed over the devices in /proc/swaps */
+bool
+swap_update()
+{
+   uint64_t size, used;
+   char *p;
+   int   old_used = sysinfo.swap_used;
+   int   old_total = sysinfo.swap_total;
+
+   sysinfo.swap_used = sysinfo.swap_total = 0;
+
+   /* "Filename Type Size Used Priority", sizes in kilobytes */
+   p = next_line(proc_read(&proc_swaps));
+   for (; *p != '\0'; p = next_line(p)) {
+      p = skip_field(skip_field(p));
+      p = scan_u64(p, &size);
+      p = scan_u64(p, &used);
+      sysinfo.swap_total += size;
+      sysinfo.swap_used  += used;
+   }
+
+   return sysinfo.swap_used != old_used || sysinfo.swap_total != old_total;
+}
+
+/*
+ * cpu history.  the lines of /proc/stat we want are
+ *    cpuN user nice system idle iowait irq softirq steal guest guest_nice
+ * (guest time is already included in user/nice).  cpus that are offline
+ * have no line, and keep their previous counters (so show no ticks).
+ */
+bool
+cpu_update()
+{
+   uint64_t v[8], *raw;
+   uint64_t cpu;
+   char *p;
+   int   rcur, i;
+
+   rcur = cpu_sample_begin();
+   memcpy(CPU_RAW(rcur, 0), CPU_RAW(!rcur, 0),
+      sysinfo.ncpu * CPUSTATES * sizeof(uint64_t));
+
+   /* skip the "cpu" line with the totals */
+   p = next_line(proc_read(&proc_stat));
+   while (p[0] == 'c' && p[1] == 'p' && p[2] == 'u') {
+      p = scan_u64(p + 3, &cpu);
+      for (i = 0; i < 8; i++)
+         p = scan_u64(p, &v[i]);
+      p = next_line(p);
+
+      if (cpu >= (uint64_t)sysinfo.ncpu)
+         continue;
+
+      raw = CPU_RAW(rcur, cpu);
+      raw[CP_USER] = v[0];
+      raw[CP_NICE] = v[1];
+      raw[CP_SYS]  = v[2];
+      raw[CP_INTR] = v[5] + v[6];
+      raw[CP_IDLE] = v[3] + v[4] + v[7];
+   }
+
+   cpu_sample_end();
+   return true;
+}
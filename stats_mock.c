@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/*
+ * Mock collectors, for the benchmark (bench.c).  They make up plausible
+ * stats instead of asking the system: every cpu random-walks around its
+ * own load, memory drifts, and the battery slowly drains.  Each call
+ * produces a new sample, so every widget has something to redraw.
+ */
+
+#include "stats.h"
+
+extern int mock_ncpu;    /* set by bench.c */
+
+static unsigned long seed = 1;
+
+/* a small deterministic generator, so runs are comparable */
+static int
+mock_rand(int n)
+{
+   seed = seed * 1103515245UL + 12345UL;
+   return (int)((seed >> 16) % (unsigned long)n);
+}
+
+
+/*****************************************************************************
+ * volume stuff
+ ****************************************************************************/
+
+void
+volume_init()
+{
+   volume.is_setup = true;
+   volume.max = 255;
+   volume.nchan = 2;
+   volume.left = volume.right = 200;
+}
+
+/* the mock mixer changes all the time, so is simply polled */
+int
+volume_fd()
+{
+   return -1;
+}
+
+bool
+volume_update()
+{
+   volume.left  = mock_rand(volume.max + 1);
+   volume.right = mock_rand(volume.max + 1);
+   volume.muted = (mock_rand(10) == 0);
+   return true;
+}
+
+void
+volume_close()
+{
+}
+
+
+/*****************************************************************************
+ * power stuff
+ ****************************************************************************/
+
+void
+power_init()
+{
+   power.is_setup = true;
+   power.ac_state = AC_OFF;
+   power.battery_life = 100;
+   power.minutes_left = 300;
+}
+
+int
+power_fd()
+{
+   return -1;
+}
+
+bool
+power_update()
+{
+   if (--power.battery_life < 0)
+      power.battery_life = 100;
+   power.minutes_left = power.battery_life * 3;
+   return true;
+}
+
+bool
+power_event()
+{
+   return power_update();
+}
+
+void
+power_close()
+{
+}
+
+
+/*****************************************************************************
+ * sysinf stuff (cpu/mem/procs)
+ ****************************************************************************/
+
+void
+sysinfo_sys_init()
+{
+   sysinfo.ncpu = mock_ncpu;
+   sysinfo.pageshift = 0;
+}
+
+void
+sysinfo_sys_close()
+{
+}
+
+bool
+procs_update()
+{
+   sysinfo.procs_total  = 100 + mock_rand(20);
+   sysinfo.procs_active = 1 + mock_rand(sysinfo.procs_total);
+   return true;
+}
+
+/* memory in kilobytes: 8G in all, of which a drifting part is in use */
+bool
+mem_update()
+{
+   static int used = 2 * 1024 * 1024;
+   int cur;
+
+   used += (mock_rand(2049) - 1024) * 64;
+   used = MAX(1024 * 1024, MIN(used, 7 * 1024 * 1024));
+
+   sysinfo.mem_physical = 8 * 1024 * 1024;
+   cur = mem_sample_begin();
+
+   MEM_HIST(MEM_ACT)[cur] = used / 2;
+   MEM_HIST(MEM_TOT)[cur] = used;
+   MEM_HIST(MEM_FRE)[cur] = 8 * 1024 * 1024 - used;
+   mem_sample_end();
+   return true;
+}
+
+bool
+swap_update()
+{
+   sysinfo.swap_total = 4 * 1024 * 1024;
+   sysinfo.swap_used  = mock_rand(1024 * 1024);
+   return true;
+}
+
+/* 100 ticks per sample and cpu, split randomly around that cpu's load */
+bool
+cpu_update()
+{
+   uint64_t *cur, *prev;
+   int   rcur, cpu, busy, user, sys;
+
+   rcur = cpu_sample_begin();
+   for (cpu = 0; cpu < sysinfo.ncpu; cpu++) {
+      cur  = CPU_RAW(rcur, cpu);
+      prev = CPU_RAW(!rcur, cpu);
+
+      busy = MIN(100, (cpu * 37) % 100 / 2 + mock_rand(51));
+      user = busy * 6 / 10;
+      sys  = busy / 4;
+
+      cur[CP_USER] = prev[CP_USER] + user;
+      cur[CP_NICE] = prev[CP_NICE] + busy / 20;
+      cur[CP_SYS]  = prev[CP_SYS]  + sys;
+      cur[CP_INTR] = prev[CP_INTR] + busy - user - sys - busy / 20;
+      cur[CP_IDLE] = prev[CP_IDLE] + 100 - busy;
+   }
+
+   cpu_sample_end();
+   return true;
+}
@@ -0,0 +1,409 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *  audio/volume by   Jacob Meuser <jakemsr@sdf.lonestar.org>
+ *  patch by          Antoine Jacoutot <ajacoutot@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * OpenBSD collectors: sysctl(3) for cpu/memory/processes, swapctl(2) for
+ * swap, apm(4) for power and sndio(7) for volume.
+ */
+
+#include <machine/apmvar.h>
+#include <sys/vmmeter.h>
+#include <sys/ioctl.h>
+#include <sys/sysctl.h>
+#include <sys/swap.h>
+#include <poll.h>
+#include <sndio.h>
+
+#include "stats.h"
+#include "profile.h"
+
+
+/*****************************************************************************
+ * volume stuff
+ ****************************************************************************/
+
+/*
+ * the output level (one control per channel, or a single one) and mute
+ * switch of sndiod(8).  sndio tells us whenever either changes, through
+ * volume_fd(), so there's no need to poll them.
+ */
+static struct sioctl_hdl *mixer = NULL;
+static unsigned int       level_addr[2];
+static int                nlevels = 0;
+static unsigned int       mute_addr;
+static bool               has_mute = false;
+
+static void
+volume_onval(void *arg, unsigned int addr, unsigned int val)
+{
+   if (nlevels > 0 && addr == level_addr[0]) {
+      volume.left = val;
+      if (nlevels == 1)
+         volume.right = val;
+   } else if (nlevels > 1 && addr == level_addr[1])
+      volume.right = val;
+   else if (has_mute && addr == mute_addr)
+      volume.muted = (val != 0);
+}
+
+static void
+volume_ondesc(void *arg, struct sioctl_desc *desc, int val)
+{
+   if (desc == NULL || desc->group[0] != '\0'
+   ||  strcmp(desc->node0.name, "output") != 0)
+      return;
+
+   if (desc->type == SIOCTL_NUM && strcmp(desc->func, "level") == 0) {
+      if (nlevels == 2)
+         return;
+      level_addr[nlevels++] = desc->addr;
+      volume.max = desc->maxval;
+   } else if (desc->type == SIOCTL_SW && strcmp(desc->func, "mute") == 0) {
+      mute_addr = desc->addr;
+      has_mute = true;
+   } else
+      return;
+
+   volume_onval(arg, desc->addr, val);
+}
+
+void
+volume_init()
+{
+   volume.is_setup = false;
+
+   if ((mixer = sioctl_open(SIO_DEVANY, SIOCTL_READ, 1)) == NULL) {
+      warnx("volume: failed to open the sndio mixer");
+      return;
+   }
+
+   /* this reads all controls and their values */
+   if (!sioctl_ondesc(mixer, volume_ondesc, NULL)
+   ||  !sioctl_onval(mixer, volume_onval, NULL)) {
+      warnx("volume: failed to read the sndio mixer");
+      volume_close();
+      return;
+   }
+
+   if (nlevels == 0) {
+      warnx("volume: no \"output.level\" mixer control");
+      volume_close();
+      return;
+   }
+
+   volume.nchan = nlevels;
+   volume.is_setup = true;
+}
+
+int
+volume_fd()
+{
+   struct pollfd pfd;
+
+   if (!volume.is_setup || sioctl_pollfd(mixer, &pfd, POLLIN) < 1)
+      return -1;
+
+   return pfd.fd;
+}
+
+/* read whatever changes sndio has for us */
+bool
+volume_update()
+{
+   volume_info_t old = volume;
+   struct pollfd pfd;
+
+   if (!volume.is_setup)
+      return false;
+
+   sioctl_pollfd(mixer, &pfd, POLLIN);
+   PROFILE_ADD(stat_syscalls, 1);
+   if (poll(&pfd, 1, 0) == -1) {
+      warn("volume update: poll");
+      return false;
+   }
+
+   if (sioctl_revents(mixer, &pfd) & POLLHUP) {
+      warnx("volume: lost the sndio mixer");
+      volume_close();
+      return true;
+   }
+
+   return volume.left != old.left || volume.right != old.right
+       || volume.muted != old.muted;
+}
+
+void
+volume_close()
+{
+   if (mixer != NULL)
+      sioctl_close(mixer);
+   mixer = NULL;
+   volume.is_setup = false;
+}
+
+
+/*****************************************************************************
+ * power stuff
+ ****************************************************************************/
+
+static int apm_fd = -1;
+
+void
+power_init()
+{
+   power.is_setup = false;
+
+   apm_fd = open("/dev/apm", O_RDONLY);
+   if (apm_fd < 0) {
+      warn("power: failed to open /dev/apm");
+      return;
+   }
+
+   power.is_setup = true;
+}
+
+int
+power_fd()
+{
+   return -1;
+}
+
+bool
+power_update()
+{
+   struct apm_power_info info;
+   power_info_t old = power;
+
+   if (!power.is_setup)
+      return false;
+
+   PROFILE_ADD(stat_syscalls, 1);
+   if (ioctl(apm_fd, APM_IOC_GETPOWER, &info) < 0) {
+      warn("power update: APM_IOC_GETPOWER");
+      return false;
+   }
+
+   switch (info.ac_state) {
+      case APM_AC_OFF:
+         power.ac_state = AC_OFF;
+         break;
+      case APM_AC_ON:
+         power.ac_state = AC_ON;
+         break;
+      default:
+         power.ac_state = AC_UNKNOWN;
+         break;
+   }
+   power.battery_life = info.battery_life;
+   /* apm's estimate is garbage (or "unknown") whenever it isn't draining */
+   if (power.ac_state == AC_OFF && info.minutes_left <= INT_MAX)
+      power.minutes_left = info.minutes_left;
+   else
+      power.minutes_left = -1;
+
+   return power.ac_state != old.ac_state
+       || power.battery_life != old.battery_life
+       || power.minutes_left != old.minutes_left;
+}
+
+/* apm has no fd to wait on, see power_fd() */
+bool
+power_event()
+{
+   return power_update();
+}
+
+void
+power_close()
+{
+   if (!power.is_setup)
+      return;
+
+   close(apm_fd);
+   apm_fd = -1;
+}
+
+
+/*****************************************************************************
+ * sysinf stuff (cpu/mem/procs)
+ ****************************************************************************/
+
+/*
+ * the swap devices, as last read.  the buffer is kept between updates and
+ * only grows when devices are added, so a steady state allocates nothing.
+ */
+static struct swapent *swapdevs = NULL;
+static int             swapdevs_size = 0;
+
+void
+sysinfo_sys_init()
+{
+   size_t size;
+   int mib[] = { CTL_HW, HW_NCPU };
+   int i;
+
+   /* setup page-shift */
+   i = getpagesize();
+   sysinfo.pageshift = 0;
+   while (i > 1) {
+      sysinfo.pageshift++;
+      i >>= 1;
+   }
+   sysinfo.pageshift -= 10;
+
+   /* get number of cpu's */
+   size = sizeof(sysinfo.ncpu);
+   if (sysctl(mib, 2, &(sysinfo.ncpu), &size, NULL, 0) == -1)
+      err(1, "sysinfo init: sysctl HW.NCPU failed");
+}
+
+void
+sysinfo_sys_close()
+{
+   free(swapdevs);
+   swapdevs = NULL;
+   swapdevs_size = 0;
+}
+
+/* number of total/active processes */
+bool
+procs_update()
+{
+   static int mib_nprocs[] = { CTL_KERN, KERN_NPROCS };
+   size_t size;
+   int    old = sysinfo.procs_total;
+
+   size = sizeof(sysinfo.procs_total);
+   PROFILE_ADD(stat_syscalls, 1);
+   if (sysctl(mib_nprocs, 2, &sysinfo.procs_total, &size, NULL, 0) == -1)
+      warn("sysinfo update: sysctl KERN.NPROCS");
+   /* TODO update procs_active here... is there easy way (sysctl)? */
+
+   return sysinfo.procs_total != old;
+}
+
+/* memory history */
+bool
+mem_update()
+{
+   static int mib_vm[] = { CTL_VM, VM_METER };
+   static int mib_physmem[] = { CTL_HW, HW_PHYSMEM64 };
+   struct vmtotal vminfo;
+   int64_t physmem;
+   size_t size;
+   int    cur;
+
+   /* that doesn't change, so is only asked for once */
+   if (sysinfo.mem_physical == 0) {
+      size = sizeof(physmem);
+      PROFILE_ADD(stat_syscalls, 1);
+      if (sysctl(mib_physmem, 2, &physmem, &size, NULL, 0) == -1)
+         err(1, "sysinfo update: HW.PHYSMEM64 failed");
+      sysinfo.mem_physical = physmem >> 10;
+   }
+
+   size = sizeof(vminfo);
+   PROFILE_ADD(stat_syscalls, 1);
+   if (sysctl(mib_vm, 2, &vminfo, &size, NULL, 0) < 0)
+      err(1, "sysinfo update: VM.METER failed");
+
+   cur = mem_sample_begin();
+
+   MEM_HIST(MEM_ACT)[cur] = vminfo.t_arm << sysinfo.pageshift;
+   MEM_HIST(MEM_TOT)[cur] = vminfo.t_rm << sysinfo.pageshift;
+   MEM_HIST(MEM_FRE)[cur] = vminfo.t_free << sysinfo.pageshift;
+   mem_sample_end();
+   return true;
+}
+
+/* swap status, summed over the enabled devices */
+bool
+swap_update()
+{
+   struct swapent *grown;
+   int    nswaps, i;
+   int    old_used = sysinfo.swap_used;
+   int    old_total = sysinfo.swap_total;
+
+   sysinfo.swap_used = sysinfo.swap_total = 0;
+   PROFILE_ADD(stat_syscalls, 1);
+   if ((nswaps = swapctl(SWAP_NSWAP, 0, 0)) == -1)
+      err(1, "sysinfo update: swapctl(SWAP_NSWAP) failed");
+
+   if (nswaps > swapdevs_size) {
+      if ((grown = reallocarray(swapdevs, nswaps, sizeof(*swapdevs))) == NULL)
+         err(1, "sysinfo update: swapdev realloc failed (%d)", nswaps);
+      swapdevs = grown;
+      swapdevs_size = nswaps;
+   }
+
+   if (nswaps > 0) {
+      PROFILE_ADD(stat_syscalls, 1);
+      /* devices may have gone away since: only count what was filled in */
+      if ((nswaps = swapctl(SWAP_STATS, swapdevs, nswaps)) == -1)
+         err(1, "sysinfo update: swapctl(SWAP_STATS) failed");
+   }
+
+   for (i = 0; i < nswaps; i++) {
+      if (swapdevs[i].se_flags & SWF_ENABLE) {
+         sysinfo.swap_used  += swapdevs[i].se_inuse / (1024 / DEV_BSIZE);
+         sysinfo.swap_total += swapdevs[i].se_nblks / (1024 / DEV_BSIZE);
+      }
+   }
+
+   return sysinfo.swap_used != old_used || sysinfo.swap_total != old_total;
+}
+
+/* cpu history */
+bool
+cpu_update()
+{
+   static int mib_cpus[] = { CTL_KERN, 0, 0 };
+   size_t    size;
+   int       cpu, rcur;
+
+   rcur = cpu_sample_begin();
+
+   /* get states for each cpu. note this is raw # of ticks */
+   size = CPUSTATES * sizeof(int64_t);
+   if (sysinfo.ncpu > 1) {
+      mib_cpus[1] = KERN_CPTIME2;
+      for (cpu = 0; cpu < sysinfo.ncpu; cpu++) {
+         mib_cpus[2] = cpu;
+         PROFILE_ADD(stat_syscalls, 1);
+         if (sysctl(mib_cpus, 3, CPU_RAW(rcur, cpu), &size, NULL, 0) < 0)
+            err(1, "sysinfo update: KERN.CPTIME2.%d failed", cpu);
+      }
+   } else {
+      int i;
+      long cpu_raw_tmp[CPUSTATES];
+      size = sizeof(cpu_raw_tmp);
+      mib_cpus[1] = KERN_CPTIME;
+      
+      PROFILE_ADD(stat_syscalls, 1);
+      if (sysctl(mib_cpus, 2, cpu_raw_tmp, &size, NULL, 0) < 0)
+         err(1, "sysinfo update: KERN.CPTIME failed");
+
+      for (i = 0; i < CPUSTATES; i++)
+         CPU_RAW(rcur, 0)[i] = cpu_raw_tmp[i];
+   }
+
+   cpu_sample_end();
+   return true;
+}
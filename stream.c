@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <err.h>
+
+#include "stats.h"
+#include "widget.h"
+#include "profile.h"
+#include "stream.h"
+
+int stream_format = STREAM_NONE;
+
+/* the most text of a part, and of a part's block around it */
+#define PART_TEXT   256
+#define PART_BLOCK  (6 * PART_TEXT + 64)   /* all of it \u escaped */
+
+static char          *record = NULL;   /* the record being built */
+static size_t         record_size;
+static unsigned long *hashes = NULL;   /* of every part, as last written */
+static bool           written = false;
+
+int
+stream_parse(const char *name)
+{
+   if (strcmp(name, "i3bar") == 0)
+      return STREAM_I3BAR;
+   if (strcmp(name, "line") == 0)
+      return STREAM_LINE;
+
+   errx(1, "unknown output format \"%s\"", name);
+   /* UNREACHABLE */
+   return STREAM_NONE;
+}
+
+/* the parts written out: those of the enabled widgets that have text */
+static int
+stream_parts()
+{
+   int i, n;
+
+   n = 0;
+   for (i = 0; i < nwidgets; i++) {
+      if (widgets[i].enabled && widgets[i].format != NULL)
+         n += widget_nparts(&widgets[i]);
+   }
+
+   return n;
+}
+
+/* write all of buf, false if stdout went away */
+static bool
+stream_out(const char *buf, size_t len)
+{
+   ssize_t n;
+
+   while (len > 0) {
+      if ((n = write(STDOUT_FILENO, buf, len)) == -1) {
+         if (errno == EINTR)
+            continue;
+         if (errno == EPIPE)
+            return false;
+         err(1, "write");
+      }
+      buf += n;
+      len -= n;
+   }
+
+   return true;
+}
+
+void
+stream_begin()
+{
+   static const char header[] = "{\"version\":1}\n[\n";
+   int n;
+
+   /*
+    * the number of parts can't change once sampling started (see
+    * cpus_nparts()), so neither can the most a record takes
+    */
+   n = stream_parts();
+   record_size = 16 + n * PART_BLOCK;
+   if ((record = malloc(record_size)) == NULL
+   ||  (hashes = calloc(n, sizeof(unsigned long))) == NULL)
+      err(1, "stream_begin: malloc failed");
+
+   if (stream_format == STREAM_I3BAR && !stream_out(header, sizeof(header) - 1))
+      exit(0);
+}
+
+/* append str to p as the inside of a JSON string */
+static char *
+json_escape(char *p, const char *str)
+{
+   static const char hex[] = "0123456789abcdef";
+   unsigned char ch;
+
+   for (; (ch = *str) != '\0'; str++) {
+      if (ch == '"' || ch == '\\') {
+         *p++ = '\\';
+         *p++ = ch;
+      } else if (ch < 0x20) {
+         memcpy(p, "\\u00", 4);
+         p[4] = hex[ch >> 4];
+         p[5] = hex[ch & 0xf];
+         p += 6;
+      } else
+         *p++ = ch;
+   }
+
+   return p;
+}
+
+bool
+stream_write()
+{
+   char text[PART_TEXT];
+   bool changed;
+   long long start;
+   unsigned long h;
+   widget_t *w;
+   char *p;
+   int i, part, n, k, len;
+
+   /* only write when something shown changed */
+   changed = !written;
+   for (i = 0, k = 0; i < nwidgets; i++) {
+      w = &widgets[i];
+      if (!w->enabled || w->format == NULL)
+         continue;
+      n = widget_nparts(w);
+      for (part = 0; part < n; part++, k++) {
+         h = w->hash(part);
+         if (h != hashes[k]) {
+            hashes[k] = h;
+            changed = true;
+         }
+      }
+   }
+   if (!changed)
+      return true;
+
+   start = profile_ns();
+   p = record;
+   if (stream_format == STREAM_I3BAR) {
+      if (written)
+         *p++ = ',';
+      *p++ = '[';
+   }
+
+   for (i = 0, k = 0; i < nwidgets; i++) {
+      w = &widgets[i];
+      if (!w->enabled || w->format == NULL)
+         continue;
+      n = widget_nparts(w);
+      for (part = 0; part < n; part++) {
+         if ((len = w->format(part, text, sizeof(text))) <= 0)
+            continue;
+
+         if (stream_format == STREAM_I3BAR) {
+            if (k++ > 0)
+               *p++ = ',';
+            p += sprintf(p, "{\"name\":\"%s\",\"instance\":\"%d\","
+               "\"full_text\":\"", w->name, part);
+            p = json_escape(p, text);
+            *p++ = '"';
+            *p++ = '}';
+         } else {
+            if (k++ > 0) {
+               memcpy(p, " | ", 3);
+               p += 3;
+            }
+            memcpy(p, text, len);
+            p += len;
+         }
+      }
+   }
+
+   if (stream_format == STREAM_I3BAR)
+      *p++ = ']';
+   *p++ = '\n';
+
+   written = true;
+   profile_frame(profile_ns() - start, 0);
+   return stream_out(record, p - record);
+}
+
+
+/*
+ * the format hooks
+ */
+
+/* like snprintf(3), appending at len and returning the new length */
+static int
+append(char *buf, int size, int len, const char *fmt, ...)
+{
+   va_list ap;
+   int n;
+
+   if (len >= size - 1)
+      return len;
+
+   va_start(ap, fmt);
+   n = vsnprintf(buf + len, size - len, fmt, ap);
+   va_end(ap);
+
+   return n < 0 ? len : MIN(len + n, size - 1);
+}
+
+int
+volume_format(int part, char *buf, int size)
+{
+   int left, right;
+
+   if (!volume.is_setup)
+      return 0;
+
+   if (volume.muted)
+      return append(buf, size, 0, "vol:mute");
+
+   left  = (int)roundf(100.0 * (float)volume.left  / (float)volume.max);
+   right = (int)roundf(100.0 * (float)volume.right / (float)volume.max);
+   return append(buf, size, 0, "vol:%d%% %d%%", left, right);
+}
+
+int
+power_format(int part, char *buf, int size)
+{
+   if (!power.is_setup)
+      return 0;
+
+   switch (power.ac_state) {
+      case AC_OFF:
+         if (power.minutes_left >= 0)
+            return append(buf, size, 0, "BAT:(%d%%,%dm)",
+               power.battery_life, power.minutes_left);
+         return append(buf, size, 0, "BAT:(%d%%)", power.battery_life);
+      case AC_ON:
+         return append(buf, size, 0, "AC:(%d%%)", power.battery_life);
+      default:
+         return 0;
+   }
+}
+
+int
+cpus_format(int part, char *buf, int size)
+{
+   static const char *names[] = { "u", "n", "s", "i", "I" };
+   int cpu, state, len;
+
+   switch (cpu_mode) {
+      case CPUS_HEATMAP:
+         cpu = -1;
+         len = append(buf, size, 0, "cpus:");
+         break;
+      case CPUS_ALL:
+         cpu = -1;
+         len = append(buf, size, 0, "cpu:");
+         break;
+      default:
+         cpu = part;
+         len = append(buf, size, 0, "cpu%d:", cpu);
+         break;
+   }
+
+   for (state = 0; state < CPUSTATES; state++)
+      len = append(buf, size, len, " %3d%%%s",
+         CPU_HIST(cpu, state)[sysinfo.current], names[state]);
+
+   return len;
+}
+
+int
+mem_format(int part, char *buf, int size)
+{
+   int cur, len;
+
+   /* fmtmem() has a single buffer, so a call per append() */
+   cur = sysinfo.mem_current;
+   len = append(buf, size, 0, "mem: %s", fmtmem(MEM_HIST(MEM_ACT)[cur]));
+   len = append(buf, size, len, "/%s", fmtmem(MEM_HIST(MEM_TOT)[cur]));
+   len = append(buf, size, len, "/%s", fmtmem(MEM_HIST(MEM_FRE)[cur]));
+
+   if (sysinfo.swap_used > 0) {
+      len = append(buf, size, len, " swap:%s", fmtmem(sysinfo.swap_used));
+      len = append(buf, size, len, "/%s", fmtmem(sysinfo.swap_total));
+   }
+
+   return len;
+}
+
+int
+procs_format(int part, char *buf, int size)
+{
+   return append(buf, size, 0, "procs: %d", sysinfo.procs_total);
+}
+
+int
+time_format(int part, char *buf, int size)
+{
+   return append(buf, size, 0, "%s", timeinfo.str);
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdbool.h>
+
+/*
+ * Instead of drawing a bar, xstatbar can write the stats to stdout (-o),
+ * for another bar to show or to log: a record of all the widgets' text
+ * whenever any of it changed.  Each record is built in a buffer allocated
+ * up front and written with a single write(2).
+ *
+ *    STREAM_I3BAR   the i3bar protocol: a header, then an endless JSON
+ *                   array with an array of blocks (one per part of a
+ *                   widget) for each record
+ *    STREAM_LINE    a line per record, the parts separated by " | "
+ *
+ * Nothing here needs X: "make headless" builds an xstatbar-headless that
+ * can only stream, and doesn't link X at all (see XSTATBAR_HEADLESS).
+ */
+#define STREAM_NONE  0
+#define STREAM_I3BAR 1
+#define STREAM_LINE  2
+extern int stream_format;
+
+/* the STREAM_* named by -o; errx()s on an unknown one */
+int  stream_parse(const char *name);
+
+/* write the header, if any; the widgets must have been sampled already */
+void stream_begin();
+
+/* write a record if anything changed, false if stdout went away */
+bool stream_write();
+
+/*
+ * The text of the stats, as the *_draw()s show it (see render.h), for
+ * the widgets' format hooks.  Each writes a NUL-terminated string of at
+ * most size - 1 bytes into buf, and returns its length (0 for nothing).
+ */
+int  volume_format(int part, char *buf, int size);
+int  power_format(int part, char *buf, int size);
+int  cpus_format(int part, char *buf, int size);
+int  mem_format(int part, char *buf, int size);
+int  procs_format(int part, char *buf, int size);
+int  time_format(int part, char *buf, int size);
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "text.h"
+#include "profile.h"
+
+
+/* advance (in pixels) of each glyph, -1 if not yet measured */
+static int      advances[256];
+static XftFont *advances_font = NULL;
+
+int
+text_width(const char *str)
+{
+   const unsigned char *s;
+   XGlyphInfo extents;
+   XftChar8   ch;
+   int width = 0;
+   int missed = 0;
+
+   /* a new font invalidates everything */
+   if (advances_font != XINFO.font) {
+      memset(advances, -1, sizeof(advances));
+      advances_font = XINFO.font;
+   }
+
+   for (s = (const unsigned char *)str; *s != '\0'; s++) {
+      if (advances[*s] < 0) {
+         ch = *s;
+         XftTextExtents8(XINFO.disp, XINFO.font, &ch, 1, &extents);
+         advances[*s] = extents.xOff;
+         PROFILE_ADD(profile.glyph_misses, 1);
+         missed = 1;
+      }
+      width += advances[*s];
+   }
+
+   if (!missed)
+      PROFILE_ADD(profile.glyph_hits, 1);
+
+   return width;
+}
@@ -0,0 +1,412 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include <stdlib.h>
+#include <err.h>
+
+#include "stats.h"
+#include "ticks.h"
+
+#if defined(__x86_64__)
+#define TICKS_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+/*
+ * a kernel: the deltas of n counters, wrapped as described in ticks.h, and
+ * the percentages of n cpus for one state, given their (scaled) deltas,
+ * half their totals and the reciprocals of those.  percents() returns
+ * the sum of what it wrote.
+ */
+typedef struct {
+   const char  *name;
+   bool       (*supported)();
+   void       (*deltas)(const uint64_t *cur, const uint64_t *prev,
+                        uint64_t *d, int n);
+   int        (*percents)(const uint32_t *d, const uint32_t *half,
+                          const uint32_t *recip, int *pct, int n);
+} kernel_t;
+
+/* scratch, for the sampler thread (or the benchmark) only */
+static uint64_t *deltas = NULL;    /* [ncpu][CPUSTATES] */
+static uint32_t *scaled = NULL;    /* [CPUSTATES][ncpu], the kernels' input */
+static uint32_t *halves = NULL;    /* [ncpu] */
+static uint32_t *recips = NULL;    /* [ncpu] */
+static int      *pcnts  = NULL;    /* [CPUSTATES][ncpu] */
+static int       scratch_ncpu = 0;
+
+
+/*****************************************************************************
+ * plain C
+ ****************************************************************************/
+
+static bool
+scalar_supported()
+{
+   return true;
+}
+
+static void
+scalar_deltas(const uint64_t *cur, const uint64_t *prev, uint64_t *d, int n)
+{
+   int i;
+
+   for (i = 0; i < n; i++) {
+      d[i] = cur[i] - prev[i];
+      if (((cur[i] | prev[i]) >> 32) == 0) {
+         d[i] &= UINT32_MAX;
+         if (d[i] >> 31)
+            d[i] = 0;
+      } else if (d[i] >> 63)
+         d[i] = 0;
+   }
+}
+
+static int
+scalar_percents(const uint32_t *d, const uint32_t *half, const uint32_t *recip,
+                int *pct, int n)
+{
+   int i, sum;
+
+   sum = 0;
+   for (i = 0; i < n; i++) {
+      pct[i] = ((uint64_t)(d[i] * 100 + half[i]) * recip[i]) >> 31;
+      sum += pct[i];
+   }
+
+   return sum;
+}
+
+
+/*****************************************************************************
+ * SSE2 (all of x86_64 has it) and AVX2
+ ****************************************************************************/
+
+#ifdef TICKS_X86
+static bool
+sse2_supported()
+{
+   return true;
+}
+
+/*
+ * 2 counters at a time.  a delta went backwards if negative at its width:
+ * the sign of its low half in the narrow lanes, of its high half if not
+ */
+static void
+sse2_deltas(const uint64_t *cur, const uint64_t *prev, uint64_t *d, int n)
+{
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i high = _mm_set1_epi64x((long long)0xffffffff00000000ULL);
+   __m128i c, p, x, narrow, sign, back;
+   int i;
+
+   for (i = 0; i + 2 <= n; i += 2) {
+      c = _mm_loadu_si128((const __m128i *)(cur + i));
+      p = _mm_loadu_si128((const __m128i *)(prev + i));
+      x = _mm_sub_epi64(c, p);
+
+      /* all ones in the lanes where both readings fit in 32 bits */
+      narrow = _mm_cmpeq_epi32(_mm_srli_epi64(_mm_or_si128(c, p), 32), zero);
+      narrow = _mm_shuffle_epi32(narrow, _MM_SHUFFLE(2, 2, 0, 0));
+
+      sign = _mm_srai_epi32(x, 31);
+      back = _mm_or_si128(
+         _mm_and_si128(narrow, _mm_shuffle_epi32(sign, _MM_SHUFFLE(2, 2, 0, 0))),
+         _mm_andnot_si128(narrow,
+            _mm_shuffle_epi32(sign, _MM_SHUFFLE(3, 3, 1, 1))));
+
+      _mm_storeu_si128((__m128i *)(d + i),
+         _mm_andnot_si128(_mm_or_si128(back, _mm_and_si128(narrow, high)), x));
+   }
+
+   scalar_deltas(cur + i, prev + i, d + i, n - i);
+}
+
+/* 4 cpus at a time; SSE2 has no 32 bit multiply, so 100x is shifts */
+static int
+sse2_percents(const uint32_t *d, const uint32_t *half, const uint32_t *recip,
+              int *pct, int n)
+{
+   __m128i x, r, even, odd, p, sum;
+   int i, s[4];
+
+   sum = _mm_setzero_si128();
+   for (i = 0; i + 4 <= n; i += 4) {
+      x = _mm_loadu_si128((const __m128i *)(d + i));
+      x = _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(x, 6),
+                                      _mm_slli_epi32(x, 5)),
+                        _mm_slli_epi32(x, 2));
+      x = _mm_add_epi32(x, _mm_loadu_si128((const __m128i *)(half + i)));
+      r = _mm_loadu_si128((const __m128i *)(recip + i));
+
+      even = _mm_srli_epi64(_mm_mul_epu32(x, r), 31);
+      odd  = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(x, 32),
+                                          _mm_srli_epi64(r, 32)), 31);
+      p = _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+
+      _mm_storeu_si128((__m128i *)(pct + i), p);
+      sum = _mm_add_epi32(sum, p);
+   }
+
+   _mm_storeu_si128((__m128i *)s, sum);
+   return s[0] + s[1] + s[2] + s[3]
+        + scalar_percents(d + i, half + i, recip + i, pct + i, n - i);
+}
+
+/* AVX2 needs the cpu to have it, and the OS to save the ymm registers */
+static bool
+avx2_supported()
+{
+   unsigned int a, b, c, d, xcr0_lo, xcr0_hi;
+
+   if (!__get_cpuid(1, &a, &b, &c, &d)
+   ||  !(c & bit_OSXSAVE) || !(c & bit_AVX))
+      return false;
+
+   __asm__ volatile ("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+   if ((xcr0_lo & 6) != 6)
+      return false;
+
+   if (__get_cpuid_max(0, NULL) < 7)
+      return false;
+   __cpuid_count(7, 0, a, b, c, d);
+   return (b & bit_AVX2) != 0;
+}
+
+/* 4 counters at a time, as sse2_deltas() */
+__attribute__((target("avx2")))
+static void
+avx2_deltas(const uint64_t *cur, const uint64_t *prev, uint64_t *d, int n)
+{
+   const __m256i zero = _mm256_setzero_si256();
+   const __m256i high = _mm256_set1_epi64x((long long)0xffffffff00000000ULL);
+   __m256i c, p, x, narrow, sign, back;
+   int i;
+
+   for (i = 0; i + 4 <= n; i += 4) {
+      c = _mm256_loadu_si256((const __m256i *)(cur + i));
+      p = _mm256_loadu_si256((const __m256i *)(prev + i));
+      x = _mm256_sub_epi64(c, p);
+
+      narrow = _mm256_cmpeq_epi64(_mm256_srli_epi64(_mm256_or_si256(c, p), 32),
+                                  zero);
+
+      sign = _mm256_srai_epi32(x, 31);
+      back = _mm256_blendv_epi8(
+         _mm256_shuffle_epi32(sign, _MM_SHUFFLE(3, 3, 1, 1)),
+         _mm256_shuffle_epi32(sign, _MM_SHUFFLE(2, 2, 0, 0)), narrow);
+
+      _mm256_storeu_si256((__m256i *)(d + i),
+         _mm256_andnot_si256(_mm256_or_si256(back,
+                                             _mm256_and_si256(narrow, high)),
+                             x));
+   }
+
+   scalar_deltas(cur + i, prev + i, d + i, n - i);
+}
+
+/* 8 cpus at a time */
+__attribute__((target("avx2")))
+static int
+avx2_percents(const uint32_t *d, const uint32_t *half, const uint32_t *recip,
+              int *pct, int n)
+{
+   const __m256i hundred = _mm256_set1_epi32(100);
+   __m256i x, r, even, odd, p, sum;
+   __m128i s;
+   int i;
+
+   sum = _mm256_setzero_si256();
+   for (i = 0; i + 8 <= n; i += 8) {
+      x = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)(d + i)),
+                             hundred);
+      x = _mm256_add_epi32(x, _mm256_loadu_si256((const __m256i *)(half + i)));
+      r = _mm256_loadu_si256((const __m256i *)(recip + i));
+
+      even = _mm256_srli_epi64(_mm256_mul_epu32(x, r), 31);
+      odd  = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32),
+                                                _mm256_srli_epi64(r, 32)), 31);
+      p = _mm256_or_si256(even, _mm256_slli_epi64(odd, 32));
+
+      _mm256_storeu_si256((__m256i *)(pct + i), p);
+      sum = _mm256_add_epi32(sum, p);
+   }
+
+   s = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                     _mm256_extracti128_si256(sum, 1));
+   s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+   s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+   return _mm_cvtsi128_si32(s)
+        + scalar_percents(d + i, half + i, recip + i, pct + i, n - i);
+}
+#endif /* TICKS_X86 */
+
+
+/*****************************************************************************
+ * dispatch
+ ****************************************************************************/
+
+static const kernel_t kernels[TICKS_KERNELS] = {
+   { "scalar", scalar_supported, scalar_deltas, scalar_percents },
+#ifdef TICKS_X86
+   { "sse2",   sse2_supported,   sse2_deltas,   sse2_percents   },
+   { "avx2",   avx2_supported,   avx2_deltas,   avx2_percents   },
+#else
+   { "sse2",   NULL,             NULL,          NULL            },
+   { "avx2",   NULL,             NULL,          NULL            },
+#endif
+};
+
+static int current = -1;
+
+bool
+ticks_supported(int kernel)
+{
+   return kernel >= 0 && kernel < TICKS_KERNELS
+       && kernels[kernel].supported != NULL && kernels[kernel].supported();
+}
+
+bool
+ticks_use(int kernel)
+{
+   if (!ticks_supported(kernel))
+      return false;
+
+   current = kernel;
+   return true;
+}
+
+int
+ticks_kernel()
+{
+   int k;
+
+   /* the best the cpu has */
+   if (current == -1) {
+      for (k = TICKS_KERNELS - 1; k > TICKS_SCALAR && !ticks_use(k); k--)
+         ;
+      current = k;
+   }
+
+   return current;
+}
+
+const char *
+ticks_kernel_name(int kernel)
+{
+   return kernels[kernel].name;
+}
+
+
+/*****************************************************************************
+ * the conversion
+ ****************************************************************************/
+
+static void
+ticks_scratch(int ncpu)
+{
+   if (ncpu <= scratch_ncpu)
+      return;
+
+   free(deltas);
+   free(scaled);
+   free(halves);
+   free(recips);
+   free(pcnts);
+   if ((deltas = calloc(ncpu * CPUSTATES, sizeof(uint64_t))) == NULL
+   ||  (scaled = calloc(ncpu * CPUSTATES, sizeof(uint32_t))) == NULL
+   ||  (halves = calloc(ncpu, sizeof(uint32_t))) == NULL
+   ||  (recips = calloc(ncpu, sizeof(uint32_t))) == NULL
+   ||  (pcnts  = calloc(ncpu * CPUSTATES, sizeof(int))) == NULL)
+      err(1, "ticks_percent: calloc failed");
+   scratch_ncpu = ncpu;
+}
+
+/* the number of bits in x */
+static int
+bits(uint64_t x)
+{
+   int n;
+
+   for (n = 0; x != 0; n++)
+      x >>= 1;
+   return n;
+}
+
+const int *
+ticks_percent(const uint64_t *cur, const uint64_t *prev, int ncpu, int *avg)
+{
+   const kernel_t *k;
+   const uint64_t *d;
+   uint64_t total, any;
+   int cpu, state, shift, online;
+
+   ticks_scratch(ncpu);
+   k = &kernels[ticks_kernel()];
+
+   k->deltas(cur, prev, deltas, ncpu * CPUSTATES);
+
+   /*
+    * every cpu's total, with its deltas scaled down until that is exact
+    * (wrapped deltas can be anything, so their sum must not overflow
+    * either), and turned around so the kernel sees a state at a time
+    */
+   online = 0;
+   for (cpu = 0; cpu < ncpu; cpu++) {
+      d = deltas + cpu * CPUSTATES;
+
+      any = total = 0;
+      for (state = 0; state < CPUSTATES; state++) {
+         any |= d[state];
+         total += d[state];
+      }
+
+      /* rarely more than a few hundred ticks, so rarely any scaling */
+      shift = 0;
+      if ((any >> 60) != 0 || (total >> TICKS_EXACT_BITS) != 0) {
+         shift = MAX(0, bits(any) + 3 - 64);
+         total = 0;
+         for (state = 0; state < CPUSTATES; state++)
+            total += d[state] >> shift;
+         shift += MAX(0, bits(total) - TICKS_EXACT_BITS);
+
+         total = 0;
+         for (state = 0; state < CPUSTATES; state++)
+            total += d[state] >> shift;
+      }
+
+      for (state = 0; state < CPUSTATES; state++)
+         scaled[state * ncpu + cpu] = d[state] >> shift;
+
+      /* total is under 1 << TICKS_EXACT_BITS now, so 32 bits do */
+      if (total != 0)
+         online++;
+      halves[cpu] = total / 2;
+      recips[cpu] = total == 0 ? 0
+                  : ((1U << 31) + (uint32_t)total - 1) / (uint32_t)total;
+   }
+
+   /* the cpus that were offline are all 0, so only count in the sums */
+   for (state = 0; state < CPUSTATES; state++) {
+      avg[state] = k->percents(scaled + state * ncpu, halves, recips,
+         pcnts + state * ncpu, ncpu) / MAX(online, 1);
+   }
+
+   return pcnts;
+}
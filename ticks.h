@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef TICKS_H
+#define TICKS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Turning the cpus' tick counters into percentages (see cpu_sample_end()),
+ * for all cpus at once.
+ *
+ * The ticks of every cpu and state since the previous sample are 64 bit
+ * deltas, taken at 32 bits if both readings of the counter fit in 32 (a
+ * platform reading a long, say), at 64 if not.  A counter that came out
+ * lower wrapped if that delta is under half the range (it was near the
+ * top); if not, it only went back a little (Linux's iowait does), and its
+ * delta is 0.
+ * Each state's share of its cpu's ticks is then rounded to a whole
+ * percent; a cpu without any ticks (gone offline) is 0 in every state.
+ *
+ * Rather than a division per cpu and state, there is one per cpu, for a
+ * 31 bit reciprocal of its total that the deltas are multiplied with.
+ * That is exact while the total is under 1 << TICKS_EXACT_BITS, so the
+ * deltas of a cpu with more ticks than that are scaled down first (which
+ * only happens with very long intervals).
+ *
+ * The deltas, and the percentages one state at a time over all cpus, are
+ * worked out by a kernel: with AVX2 or SSE2 where there are, or in plain
+ * C.  The best the cpu supports is picked on the first call.
+ */
+#define TICKS_EXACT_BITS 12
+
+#define TICKS_SCALAR 0
+#define TICKS_SSE2   1
+#define TICKS_AVX2   2
+#define TICKS_KERNELS 3
+
+/*
+ * the percentages between the samples prev and cur, each [ncpu][CPUSTATES]:
+ * those of state of every cpu are at [state * ncpu], and their mean over
+ * the cpus that had ticks (were online) goes to avg[state], rounded down.
+ * the result is valid until the next call.
+ */
+const int  *ticks_percent(const uint64_t *cur, const uint64_t *prev, int ncpu,
+                          int *avg);
+
+/* the kernel in use; ticks_use() is false if the cpu can't run that one */
+int         ticks_kernel();
+bool        ticks_use(int kernel);
+const char *ticks_kernel_name(int kernel);
+
+/* whether the cpu can run a kernel of that kind (the spans' too, span.h) */
+bool        ticks_supported(int kernel);
+
+#endif
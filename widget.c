@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include <string.h>
+#include <err.h>
+
+#include "stats.h"
+#include "widget.h"
+#include "profile.h"
+#include "stream.h"
+#ifndef XSTATBAR_HEADLESS
+#include "render.h"
+#endif
+
+/*
+ * the headless build (see stream.h) has none of render.c: its widgets
+ * are written out, never drawn.
+ */
+#ifdef XSTATBAR_HEADLESS
+#define DRAWN(draw, color)  NULL, NULL
+#define SINGLE_PART_DRAW(name)
+#else
+#define DRAWN(draw, color)  draw, color
+#define SINGLE_PART_DRAW(name)                                         \
+static int                                                             \
+name##_part_draw(int part, bool compact, XftColor *c, int x, int y)    \
+{                                                                      \
+   return name##_draw(c, x, y, compact);                               \
+}
+#endif
+
+/* give the single-part widgets the hash/draw signature of widget_t */
+#define SINGLE_PART(name)                                              \
+static unsigned long                                                   \
+name##_part_hash(int part)                                             \
+{                                                                      \
+   return name##_hash();                                               \
+}                                                                      \
+SINGLE_PART_DRAW(name)
+
+SINGLE_PART(mem)
+SINGLE_PART(procs)
+SINGLE_PART(power)
+SINGLE_PART(volume)
+SINGLE_PART(time)
+
+/* how the cpus are shown, and the graphs (set by -c, -H, -g and -G) */
+int cpu_mode = CPUS_EACH;
+int heatmap_width;
+int graph_width = 45;
+int cpu_window = 0;
+int mem_window = 0;
+bool graph_width_fixed = false;
+bool graph_window_fixed = false;
+
+/* the cpus: a part per cpu, or one for all of them (see cpu_mode) */
+static int
+cpus_nparts()
+{
+   return cpu_mode == CPUS_EACH ? sysinfo.ncpu : 1;
+}
+
+static unsigned long
+cpus_hash(int part)
+{
+   switch (cpu_mode) {
+      case CPUS_HEATMAP:
+         return cpu_heatmap_hash(heatmap_width);
+      case CPUS_ALL:
+         return cpu_hash(-1);
+      default:
+         return cpu_hash(part);
+   }
+}
+
+#ifndef XSTATBAR_HEADLESS
+static int
+cpus_draw(int part, bool compact, XftColor *c, int x, int y)
+{
+   switch (cpu_mode) {
+      case CPUS_HEATMAP:
+         return cpu_heatmap_draw(c, x, y, heatmap_width, compact);
+      case CPUS_ALL:
+         return cpu_draw(-1, c, x, y, compact);
+      default:
+         return cpu_draw(part, c, x, y, compact);
+   }
+}
+#endif
+
+/* all widgets (where they are drawn is up to the layout, see layout.h) */
+widget_t widgets[] = {
+/* name      on    period  init         update         close         fd         event        poll   nparts       hash              format         draw / color */
+ { "cpu",    true,   1000, NULL,        cpu_update,    NULL,         NULL,      NULL,        false, cpus_nparts, cpus_hash,        cpus_format,   DRAWN(cpus_draw,        &COLOR7) }, /* period set by -s */
+ { "mem",    true,   1000, NULL,        mem_update,    NULL,         NULL,      NULL,        false, NULL,        mem_part_hash,    mem_format,    DRAWN(mem_part_draw,    &COLOR7) },
+ { "swap",   true,  10000, NULL,        swap_update,   NULL,         NULL,      NULL,        false, NULL,        NULL,             NULL,          DRAWN(NULL,             NULL)    }, /* drawn by mem */
+ { "procs",  true,   1000, NULL,        procs_update,  NULL,         NULL,      NULL,        false, NULL,        procs_part_hash,  procs_format,  DRAWN(procs_part_draw,  &COLOR7) },
+ { "power",  true,  30000, power_init,  power_update,  power_close,  power_fd,  power_event, true,  NULL,        power_part_hash,  power_format,  DRAWN(power_part_draw,  &COLOR7) },
+ { "volume", true,   1000, volume_init, volume_update, volume_close, volume_fd, NULL,        false, NULL,        volume_part_hash, volume_format, DRAWN(volume_part_draw, &COLOR7) },
+ { "time",   true,   1000, NULL,        time_update,   NULL,         NULL,      NULL,        false, NULL,        time_part_hash,   time_format,   DRAWN(time_part_draw,   &COLOR3) }, /* period set by -t */
+};
+const int nwidgets = sizeof(widgets) / sizeof(widgets[0]);
+
+widget_t *
+widget_find(const char *name)
+{
+   int i;
+
+   for (i = 0; i < nwidgets; i++) {
+      if (strcmp(widgets[i].name, name) == 0)
+         return &widgets[i];
+   }
+
+   return NULL;
+}
+
+/* set the graphs' window, from milliseconds, in samples of what they show */
+void
+graphs_window(int ms)
+{
+   cpu_window = MAX(1, ms / widget_find("cpu")->period);
+   mem_window = MAX(1, ms / widget_find("mem")->period);
+}
+
+/* the history the graphs (and the heatmap) need (see hist_size_for()) */
+int
+graphs_hist_size()
+{
+   return MAX(hist_size_for(MAX(graph_width, heatmap_width), cpu_window),
+              hist_size_for(graph_width, mem_window));
+}
+
+/* disable the widgets in a comma separated list of names */
+void
+widget_disable(const char *names)
+{
+   char *list, *name, *next;
+   widget_t *w;
+
+   if ((list = strdup(names)) == NULL)
+      err(1, "failed to strdup(3) widget list");
+
+   for (next = list; (name = strsep(&next, ",")) != NULL; ) {
+      if ((w = widget_find(name)) == NULL)
+         errx(1, "unknown widget \"%s\"", name);
+      w->enabled = false;
+   }
+
+   free(list);
+}
+
+static bool
+widget_run(widget_t *w, bool (*update)())
+{
+   long long start = profile_ns();
+   bool fresh;
+
+   fresh = update();
+   PROFILE_ADD(w->update_ns, profile_ns() - start);
+   PROFILE_ADD(w->updates, 1);
+   return fresh;
+}
+
+bool
+widget_update(widget_t *w)
+{
+   return widget_run(w, w->update);
+}
+
+/* w's fd is readable: its event, if it has one, else its update */
+bool
+widget_event(widget_t *w)
+{
+   return widget_run(w, w->event != NULL ? w->event : w->update);
+}
+
+int
+widget_draw(widget_t *w, int part, bool compact, int x, int y)
+{
+   long long start = profile_ns();
+   int width;
+
+   width = w->draw(part, compact, w->color, x, y);
+   PROFILE_ADD(w->draw_ns, profile_ns() - start);
+   PROFILE_ADD(w->draws, 1);
+   return width;
+}
+
+int
+widget_nparts(widget_t *w)
+{
+   return w->nparts != NULL ? w->nparts() : 1;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2009 Ryan Flannery <ryan.flannery@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#ifndef WIDGET_H
+#define WIDGET_H
+
+#include <stdbool.h>
+
+/* an Xft color, without needing X (see stream.h) */
+struct _XftColor;
+
+/*
+ * A widget is one stat on the bar: how it is sampled, on the sampler
+ * thread (init/update/close, with an update every "period" milliseconds),
+ * and how it is drawn, on the main thread (hash/draw, see display.c), or
+ * written out as text (format, see stream.h).
+ * A widget whose fd hook gives a descriptor is updated whenever that
+ * descriptor becomes readable, and no longer periodically unless it asks
+ * for both (the battery level changes without telling, AC plugging not).
+ *
+ * A widget may draw in several parts, each with its own damage tracking
+ * (one per cpu, say), or not at all (swap, which mem draws), and in full
+ * or compact.  Where the parts go on the bar is up to the layout (see
+ * layout.h).
+ */
+typedef struct {
+   const char     *name;
+   bool            enabled;
+   int             period;        /* in milliseconds */
+
+   void          (*init)();       /* each may be NULL */
+   bool          (*update)();     /* returns true if it produced new data */
+   void          (*close)();
+   int           (*fd)();         /* -1 if it has to be polled */
+   bool          (*event)();      /* on fd, in place of update; may be NULL */
+   bool            fd_poll;       /* with an fd, still update every period */
+
+   int           (*nparts)();     /* NULL for one part */
+   unsigned long (*hash)(int part);
+   int           (*format)(int part, char *buf, int size);
+   int           (*draw)(int part, bool compact, struct _XftColor *c, int x, int y);
+   struct _XftColor *color;       /* draw and color are NULL when headless */
+
+   bool            aligned;       /* updated on the wall clock, see sched.h */
+   long long       due;           /* next update, kept by sched.c */
+   long long       wall_due;      /* and on the wall clock, if aligned */
+   bool            evented;       /* updated on its fd, see sampler.c */
+
+   /* what the widget costs, in nanoseconds */
+   unsigned long   updates;
+   long long       update_ns;
+   unsigned long   draws;
+   long long       draw_ns;
+} widget_t;
+
+extern widget_t  widgets[];
+extern const int nwidgets;
+
+/* how the cpus are shown: a graph each, one for all of them, or a heatmap */
+#define CPUS_EACH    0
+#define CPUS_ALL     1
+#define CPUS_HEATMAP 2
+extern int cpu_mode;
+extern int heatmap_width;   /* in pixels */
+
+/* how wide the graphs are, and how many samples back they go (0: a pixel each) */
+extern int graph_width;
+extern int cpu_window;
+extern int mem_window;
+
+/* set by -g and -G, which the X resources then don't change */
+extern bool graph_width_fixed;
+extern bool graph_window_fixed;
+
+void graphs_window(int ms);
+int  graphs_hist_size();
+
+widget_t *widget_find(const char *name);
+void      widget_disable(const char *names);
+
+/* run a widget's update/draw, accounting for the time it took */
+bool      widget_update(widget_t *w);
+bool      widget_event(widget_t *w);
+int       widget_draw(widget_t *w, int part, bool compact, int x, int y);
+int       widget_nparts(widget_t *w);
+
+#endif
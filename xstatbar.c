@@ -17,41 +17,59 @@
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
+#include <poll.h>
 #include <unistd.h>
 #include <errno.h>
 #include <math.h>
 #include <time.h>
 #include <err.h>
 
-#include "xstatbar.h"
 #include "stats.h"
+#include "sched.h"
+#include "sampler.h"
+#include "widget.h"
+#include "profile.h"
+#include "history.h"
+#include "stream.h"
+#ifndef XSTATBAR_HEADLESS
+#include "xstatbar.h"
+#include "raster.h"
+#endif
 
-/* extern's from xstatbar.h */
-xinfo_t  XINFO;
-
-XftColor COLOR0, COLOR1, COLOR2, COLOR3,
-         COLOR4, COLOR5, COLOR6, COLOR7;
+/*
+ * built with XSTATBAR_HEADLESS, xstatbar has no X at all and can only
+ * write the stats out (see stream.h), so has none of the options for the
+ * bar
+ */
+#ifdef XSTATBAR_HEADLESS
+#define OPTIONS "s:t:TcH:g:G:d:P:o:"
+#else
+#define OPTIONS "x:y:w:h:O:l:s:f:t:TcH:g:G:d:RP:o:"
+#endif
 
 /* signal flags */
 volatile sig_atomic_t VSIG_QUIT = 0;
+volatile sig_atomic_t VSIG_DUMP = 0;
 
 /* local functions */
 void signal_handler(int sig);
 void process_signals();
 void cleanup();
+void stream();
 void usage(const char *pname);
-void setup_x(int x, int y, int w, int h, const char *font);
-void draw(int);
+int  parse_interval(const char *str);
 
 int
 main (int argc, char *argv[])
 {
    const char *errstr;
-   char *font;
    char  ch;
+   widget_t *timew;
+   int   interval, window, hist, i;
+#ifndef XSTATBAR_HEADLESS
+   struct pollfd pfd[2];
+   char *font;
    int   x, y, w, h;
-   int   sleep_seconds;
-   int   consolidate_cpus = 0;
 
    /* set defaults */
    x = 0;
@@ -59,12 +77,17 @@ main (int argc, char *argv[])
    w = 0;
    h = 13;
    font = "Fixed-6";
+#else
+   stream_format = STREAM_LINE;
+#endif
    time_fmt = "%a %d %b %Y %I:%M:%S %p";
-   sleep_seconds = 1;
+   interval = 1000;
+   window = 0;
 
    /* parse command line */
-   while ((ch = getopt(argc, argv, "x:y:w:h:s:f:t:Tc")) != -1) {
+   while ((ch = getopt(argc, argv, OPTIONS)) != -1) {
       switch (ch) {
+#ifndef XSTATBAR_HEADLESS
          case 'x':
             x = strtonum(optarg, 0, INT_MAX, &errstr);
             if (errstr)
@@ -89,10 +112,12 @@ main (int argc, char *argv[])
                errx(1, "illegal height value \"%s\": %s", optarg, errstr);
             break;
 
-         case 's':
-            sleep_seconds = strtonum(optarg, 0, INT_MAX, &errstr);
-            if (errstr)
-               errx(1, "illegal sleep value \"%s\": %s", optarg, errstr);
+         case 'O':
+            bar_outputs = optarg;
+            break;
+
+         case 'l':
+            bar_layout = optarg;
             break;
 
          case 'f':
@@ -101,6 +126,15 @@ main (int argc, char *argv[])
                err(1, "failed to strdup(3) font");
             break;
 
+         case 'R':
+            raster_enabled = true;
+            break;
+#endif
+
+         case 's':
+            interval = parse_interval(optarg);
+            break;
+
          case 't':
             time_fmt = strdup(optarg);
             if (time_fmt == NULL)
@@ -112,7 +146,38 @@ main (int argc, char *argv[])
             break;
 
          case 'c':
-            consolidate_cpus = 1;
+            cpu_mode = CPUS_ALL;
+            break;
+
+         case 'H':
+            cpu_mode = CPUS_HEATMAP;
+            heatmap_width = strtonum(optarg, 1, INT_MAX, &errstr);
+            if (errstr)
+               errx(1, "illegal heatmap width \"%s\": %s", optarg, errstr);
+            break;
+
+         case 'g':
+            graph_width = strtonum(optarg, 1, INT_MAX, &errstr);
+            if (errstr)
+               errx(1, "illegal graph width \"%s\": %s", optarg, errstr);
+            graph_width_fixed = true;
+            break;
+
+         case 'G':
+            window = parse_interval(optarg);
+            graph_window_fixed = true;
+            break;
+
+         case 'd':
+            widget_disable(optarg);
+            break;
+
+         case 'P':
+            history_path = optarg;
+            break;
+
+         case 'o':
+            stream_format = stream_parse(optarg);
             break;
 
          case '?':
@@ -123,46 +188,149 @@ main (int argc, char *argv[])
       }
    }
 
-   /* init stat collectors */
-   volume_init();
-   power_init();
-   sysinfo_init(45);
+   /*
+    * the cpus are sampled every "interval"; nothing else is sampled more
+    * often than that, and the slow stuff (swap, battery) much less often.
+    */
+   for (i = 0; i < nwidgets; i++) {
+      if (widgets[i].period < interval && widgets[i].update != time_update)
+         widgets[i].period = interval;
+   }
+   widget_find("cpu")->period = interval;
+
+   /* the clock only wakes up when what it shows can change */
+   timew = widget_find("time");
+   timew->period  = time_granularity(time_fmt);
+   timew->aligned = true;
+
+   /* the graphs' window, in samples of what they show */
+   if (window > 0)
+      graphs_window(window);
+   hist = graphs_hist_size();
+
+   profile_init();
+
+   /* start the widget updates (on their own thread) */
+   sampler_start(widgets, nwidgets, hist);
+   sampler_read();
+
+   /* shutdown function, and dumping the profile */
+   signal(SIGINT,  signal_handler);
+   signal(SIGUSR1, signal_handler);
 
+   /* with -o, there's no bar: the stats are only written out */
+   if (stream_format != STREAM_NONE)
+      stream();
+
+#ifndef XSTATBAR_HEADLESS
    /* setup X window */
    setup_x(x, y, w, h, font);
 
-   /* shutdown function */
-   signal(SIGINT,  signal_handler);
+   /*
+    * sleep in poll(2) on the X connection, so events are handled right
+    * away, and on the sampler, which wakes us whenever a widget had
+    * something new.  only then is the bar redrawn.
+    */
+   pfd[0].fd = ConnectionNumber(XINFO.disp);
+   pfd[0].events = POLLIN;
+   pfd[1].fd = sampler_fd();
+   pfd[1].events = POLLIN;
+   draw();
 
    while (1) {
       /* handle any signals */
       process_signals();
 
-      /* update stats */
-      volume_update();
-      power_update();
-      sysinfo_update();
+      if (process_events())
+         draw();
+      XFlush(XINFO.disp);
+      PROFILE_ADD(profile.flushes, 1);
 
-      /* draw */
-      draw(consolidate_cpus);
-      XSync(XINFO.disp, False);
+      /* XPending() may have queued events without us seeing them on the fd */
+      if (XPending(XINFO.disp))
+         continue;
+
+      if (poll(pfd, 2, -1) == -1) {
+         if (errno != EINTR)
+            err(1, "poll");
+         continue;
+      }
 
-      /* sleep */
-      sleep(sleep_seconds);
+      if ((pfd[1].revents & POLLIN) && sampler_read())
+         draw();
    }
+#endif
 
    /* UNREACHABLE */
    return 0;
 }
 
+/*
+ * write the stats out whenever the sampler has something new, until
+ * stdout goes away: as a status command, that's when the bar quits.
+ */
+void
+stream()
+{
+   struct pollfd pfd;
+
+   signal(SIGTERM, signal_handler);
+   signal(SIGPIPE, SIG_IGN);
+
+   pfd.fd = sampler_fd();
+   pfd.events = POLLIN;
+   stream_begin();
+   if (!stream_write())
+      cleanup();
+
+   while (1) {
+      process_signals();
+
+      if (poll(&pfd, 1, -1) == -1) {
+         if (errno != EINTR)
+            err(1, "poll");
+         continue;
+      }
+
+      if ((pfd.revents & POLLIN) && sampler_read() && !stream_write())
+         cleanup();
+   }
+}
+
+/* parse an interval in (possibly fractional) seconds into milliseconds */
+int
+parse_interval(const char *str)
+{
+   char   *end;
+   double  secs;
+
+   errno = 0;
+   secs = strtod(str, &end);
+   if (errno || end == str || *end != '\0')
+      errx(1, "illegal sleep value \"%s\"", str);
+   if (secs < 0.001 || secs > INT_MAX / 1000)
+      errx(1, "illegal sleep value \"%s\": out of range", str);
+
+   return (int)(secs * 1000 + 0.5);
+}
+
 /* print usage and exit */
 void
 usage(const char *pname)
 {
+#ifdef XSTATBAR_HEADLESS
+   fprintf(stderr, "\
+usage: %s [-o i3bar | line] [-s secs] [-t time-format] [-T] [-c | -H width]\n\
+          [-g width] [-G secs] [-d widget[,widget...]] [-P history-file]\n",
+   pname);
+#else
    fprintf(stderr, "\
-usage: %s [-x xoffset] [-y yoffset] [-w width] [-h height] [-s secs]\n\
-          [-f font] [-t time-format] [-T]\n",
+usage: %s [-x xoffset] [-y yoffset] [-w width] [-h height]\n\
+          [-O output[,output...]] [-l layout] [-s secs] [-f font]\n\
+          [-t time-format] [-T] [-c | -H width] [-g width] [-G secs]\n\
+          [-d widget[,widget...]] [-R] [-P history-file] [-o i3bar | line]\n",
    pname);
+#endif
    exit(0);
 }
 
@@ -177,6 +345,9 @@ signal_handler(int sig)
       case SIGTERM:
          VSIG_QUIT = 1;
          break;
+      case SIGUSR1:
+         VSIG_DUMP = 1;
+         break;
    }
 }
 
@@ -188,276 +359,25 @@ process_signals()
       VSIG_QUIT = 0;
    }
 
+   if (VSIG_DUMP) {
+      profile_dump();
+      VSIG_DUMP = 0;
+   }
+
 }
 
 /* exit handler */
 void
 cleanup()
 {
-  /* x teardown */
-  XdbeDeallocateBackBufferName(XINFO.disp, XINFO.backbuf);
-  XrmDestroyDatabase(XINFO.xrdb);
-  XClearWindow(XINFO.disp,   XINFO.win);
-  XDestroyWindow(XINFO.disp, XINFO.win);
-  XftDrawDestroy( XINFO.xftdraw );
-
-  XftColorFree(XINFO.disp, XINFO.vis, DefaultColormap( XINFO.disp, XINFO.screen ), &COLOR0);
-  XftColorFree(XINFO.disp, XINFO.vis, DefaultColormap( XINFO.disp, XINFO.screen ), &COLOR1);
-  XftColorFree(XINFO.disp, XINFO.vis, DefaultColormap( XINFO.disp, XINFO.screen ), &COLOR2);
-  XftColorFree(XINFO.disp, XINFO.vis, DefaultColormap( XINFO.disp, XINFO.screen ), &COLOR3);
-  XftColorFree(XINFO.disp, XINFO.vis, DefaultColormap( XINFO.disp, XINFO.screen ), &COLOR4);
-  XftColorFree(XINFO.disp, XINFO.vis, DefaultColormap( XINFO.disp, XINFO.screen ), &COLOR5);
-  XftColorFree(XINFO.disp, XINFO.vis, DefaultColormap( XINFO.disp, XINFO.screen ), &COLOR6);
-  XftColorFree(XINFO.disp, XINFO.vis, DefaultColormap( XINFO.disp, XINFO.screen ), &COLOR7);
-
-  XCloseDisplay(XINFO.disp);
+  profile_exit();
+#ifndef XSTATBAR_HEADLESS
+  if (stream_format == STREAM_NONE)
+     close_x();
+#endif
 
   /* stats teardown */
-  volume_close();
-  power_close();
-  sysinfo_close();
+  sampler_stop();
 
   exit(0);
 }
-
-/* get resource from X Resource database */
-const char *
-get_resource(const char *resource)
-{
-  static char name[256], class[256], *type;
-  XrmValue value;
-
-  if (!XINFO.xrdb)
-    return NULL;
-#define RESCLASS "xstatbar"
-#define RESNAME "XStatBar"
-  snprintf(name, sizeof(name), "%s.%s", RESNAME, resource);
-  snprintf(class, sizeof(class), "%s.%s", RESCLASS, resource);
-  XrmGetResource(XINFO.xrdb, name, class, &type, &value);
-  if (value.addr)
-    return value.addr;
-  return NULL;
-}
-
-XRenderColor*
-hex_to_color(const char *hex)
-{
-  if (strlen(hex) < 7) {
-    return NULL;
-  } 
-
-  XRenderColor *color = malloc(sizeof(XRenderColor));
-  long number = strtoll( &hex[1], NULL, 16);
-  long r = number >> 16;
-  long g = number >> 8 & 0xFF;
-  long b = number & 0xFF;
-
-
-  color->red = ((r + 1) * 64 * 16) - 1;
-  color->green = ((g + 1) * 64 * 16) - 1;
-  color->blue = ((b + 1) * 64 * 16) - 1;
-  color->alpha = 0xffff;
-
-  return color;
-}
-
-void
-calc_color(const char *name, XRenderColor *def, XftColor *col)
-{
-  const char *color;
-  color = get_resource(name);
-  XftColor lookup_color;
-  XRenderColor *hex_color;
-
-  if (color) {
-    if (color[0] == '#') {
-      hex_color = hex_to_color(color);
-      if (XftColorAllocValue(XINFO.disp, 
-            XINFO.vis, 
-            DefaultColormap( XINFO.disp, XINFO.screen ), 
-            hex_color, 
-            &lookup_color) ) {
-        *col = lookup_color;
-        return;
-      }
-     } else {
-      if (XftColorAllocName(XINFO.disp, 
-            XINFO.vis, 
-            DefaultColormap( XINFO.disp, XINFO.screen ), 
-            color, 
-            &lookup_color) ) {
-        *col = lookup_color;
-        return;
-      } else {
-      }
-    }
-  }
-
-  XftColorAllocValue(XINFO.disp, XINFO.vis, DefaultColormap( XINFO.disp, XINFO.screen ), def, col);
-}
-
-/* setup all colors used */
-void
-setup_colors()
-{
-  XRenderColor color0  = { .red = 0x0,    .green = 0x0,    .blue = 0x0,    .alpha = 0xffff };
-  XRenderColor color1  = { .red = 0xffff, .green = 0x0,    .blue = 0x0,    .alpha = 0xffff };
-  XRenderColor color2  = { .red = 0x0,    .green = 0xf000, .blue = 0x0,    .alpha = 0xffff };
-  XRenderColor color3  = { .red = 0xffff, .green = 0xffff, .blue = 0x0,    .alpha = 0xffff };
-  XRenderColor color4  = { .red = 0x0,    .green = 0x0,    .blue = 0xffff, .alpha = 0xffff };
-  XRenderColor color5  = { .red = 0xffff, .green = 0x0,    .blue = 0xffff, .alpha = 0xffff };
-  XRenderColor color6  = { .red = 0x0,    .green = 0xffff, .blue = 0xffff, .alpha = 0xffff };
-  XRenderColor color7  = { .red = 0xffff, .green = 0xffff, .blue = 0xffff, .alpha = 0xffff };
-
-  calc_color("color0", &color0, &COLOR0);
-  calc_color("color1", &color1, &COLOR1);
-  calc_color("color2", &color2, &COLOR2);
-  calc_color("color3", &color3, &COLOR3);
-  calc_color("color4", &color4, &COLOR4);
-  calc_color("color5", &color5, &COLOR5);
-  calc_color("color6", &color6, &COLOR6);
-  calc_color("color7", &color7, &COLOR7);
-}
-
-int
-calculate_width_of_default_screen()
-{
-  int nsizes;
-  XRRScreenSize* randrsize = XRRSizes(XINFO.disp, XINFO.screen, &nsizes);
-
-  if (nsizes != 0) {
-    Rotation current = 0;
-    XRRScreenConfiguration * sc;
-
-    sc = XRRGetScreenInfo (XINFO.disp, RootWindow (XINFO.disp, XINFO.screen));
-    int current_size = XRRConfigCurrentConfiguration (sc, &current);
-
-    if (current_size < nsizes) {
-
-      XRRRotations(XINFO.disp, XINFO.screen, &current);
-      randrsize += current_size;
-
-      bool rot = current & RR_Rotate_90 || current & RR_Rotate_270;
-      return rot ? randrsize->height : randrsize->width;
-    }
-  }
-  return DisplayWidth(XINFO.disp, XINFO.screen);
-}
-
-/* setup x window */
-void
-setup_x(int x, int y, int w, int h, const char *font)
-{
-  XSetWindowAttributes x11_window_attributes;
-  Atom type;
-  unsigned long struts[12];
-  char *xrms = NULL;
-
-  /* open display */
-  if (!(XINFO.disp = XOpenDisplay(NULL)))
-      errx(1, "can't open X11 display.");
-  /* initialize resource manager */
-  XrmInitialize();
-  /* setup various defaults/settings */
-  XINFO.screen = DefaultScreen(XINFO.disp);
-  XINFO.height = h;
-  XINFO.depth  = DefaultDepth(XINFO.disp, XINFO.screen);
-  XINFO.vis    = DefaultVisual(XINFO.disp, XINFO.screen);
-  XINFO.width  = w ? w : calculate_width_of_default_screen();
-  x11_window_attributes.override_redirect = 1;
-
-  if(!(XINFO.xrdb = XrmGetDatabase(XINFO.disp))) {
-    xrms = XResourceManagerString(XINFO.disp);
-    if (xrms)
-      XINFO.xrdb = XrmGetStringDatabase(xrms);
-
-  }
-
-  /* create window */
-  XINFO.win = XCreateWindow(
-    XINFO.disp, DefaultRootWindow(XINFO.disp),
-    x, y,
-    XINFO.width, XINFO.height,
-    1,
-    CopyFromParent, InputOutput, XINFO.vis,
-    CWOverrideRedirect, &x11_window_attributes
-  );
-
-  /* setup window manager hints */
-  type = XInternAtom(XINFO.disp, "_NET_WM_WINDOW_TYPE_DOCK", False);
-  XChangeProperty(XINFO.disp, XINFO.win, XInternAtom(XINFO.disp, "_NET_WM_WINDOW_TYPE", False),
-       XA_ATOM, 32, PropModeReplace, (unsigned char*)&type, 1);
-  bzero(struts, sizeof(struts));
-  enum { left, right, top, bottom, left_start_y, left_end_y, right_start_y,
-    right_end_y, top_start_x, top_end_x, bottom_start_x, bottom_end_x };
-  if (y <= DisplayHeight(XINFO.disp, XINFO.screen)/2) {
-    struts[top] = y + XINFO.height;
-    struts[top_start_x] = x;
-    struts[top_end_x] = x + XINFO.width;
-  } else {
-    struts[bottom] = DisplayHeight(XINFO.disp, XINFO.screen) - y;
-    struts[bottom_start_x] = x;
-    struts[bottom_end_x] = x + XINFO.width;
-  }
-  XChangeProperty(XINFO.disp, XINFO.win, XInternAtom(XINFO.disp, "_NET_WM_STRUT_PARTIAL", False),
-       XA_CARDINAL, 32, PropModeReplace, (unsigned char*)struts, 12);
-
-  XINFO.backbuf = XdbeAllocateBackBufferName(XINFO.disp, XINFO.win, XdbeBackground);
-  XINFO.xftdraw = XftDrawCreate(XINFO.disp, XINFO.backbuf,
-                                 DefaultVisual(XINFO.disp,XINFO.screen),
-                                 DefaultColormap( XINFO.disp, XINFO.screen ) );
-
-  /* setup font */
-  XINFO.font = XftFontOpenName(XINFO.disp, XINFO.screen, font); 
-  if (!XINFO.font)
-    errx(1, "XLoadQueryFont failed for \"%s\"", font);
-
-  /* connect window to display */
-  XMapWindow(XINFO.disp, XINFO.win);
-
-  XMoveWindow(XINFO.disp, XINFO.win, x, y);
-   
-  setup_colors();
-}
-
-void
-swap_buf()
-{
-  XdbeSwapInfo swpinfo[1] = {{XINFO.win, XdbeBackground}};
-  XdbeSwapBuffers(XINFO.disp, swpinfo, 1);
-}
-
-/* draw all stats */
-void
-draw(int consolidate_cpus)
-{
-   static int spacing = 10;
-   int x, y;
-   int cpu;
- 
-   /* paint over the existing pixmap */
-   swap_buf();
-   XftDrawRect(XINFO.xftdraw, &COLOR0, 0, 0, XINFO.width, XINFO.height);
-
-
-   /* determine starting x and y */
-   y = XINFO.height - XINFO.font->descent;
-   x = 0;
-
-   /* start drawing stats */
-   if (consolidate_cpus)
-      x += cpu_draw(-1, &COLOR7, x, y) + spacing;
-   else
-      for (cpu = 0; cpu < sysinfo.ncpu; cpu++)
-         x += cpu_draw(cpu, &COLOR7, x, y) + spacing;
-
-   x += mem_draw(&COLOR7, x, y) + spacing;
-   x += procs_draw(&COLOR7, x, y) + spacing;
-   x += power_draw(&COLOR7, x, y) + spacing;
-   x += volume_draw(&COLOR7, x, y) + spacing;
-   time_draw(&COLOR3, x, y);
-
-   swap_buf();
-   XFlush(XINFO.disp);
-}
-
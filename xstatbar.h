@@ -17,6 +17,8 @@
 #ifndef XSTATBAR_H
 #define XSTATBAR_H
 
+#include <stdbool.h>
+
 /* X */
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
@@ -24,23 +26,46 @@
 #include <X11/Xatom.h>
 #include <X11/Xresource.h>
 #include <X11/extensions/shape.h>
-#include <X11/extensions/Xdbe.h>
 #include <X11/extensions/Xrandr.h>
 
+/*
+ * a bar: there is one on every connected RandR output (or those given
+ * with -O), or one on the whole screen without RandR 1.2.  they all show
+ * the same stats, from the same samples and history.
+ */
+typedef struct bar {
+   char           output[64];     /* "" for the whole screen */
+   Window         win;
+   Pixmap         frame;          /* everything is drawn here first */
+   XftDraw       *xftdraw;
+   int            x, y;           /* on the screen */
+   unsigned int   width;
+   bool           seen;           /* still there, while the outputs are scanned */
+   struct damage_state *damage;   /* what was drawn where, see display.c */
+   struct layout *layout;         /* where, see layout.h */
+   struct bar    *next;
+} bar_t;
+
 /* structure to wrap all necessary x stuff */
 typedef struct xinfo {
    Display       *disp;
-   Window         win;
    Visual        *vis;
    XftFont       *font;
-   XftDraw			 *xftdraw;
-   XdbeBackBuffer backbuf;
+   GC             gc;
    XrmDatabase    xrdb;
 
    int            screen;
    int            depth;
-   unsigned int   width;
+   int            x, y;           /* of each bar, from its output's corner */
+   unsigned int   fixed_width;    /* given -w, so don't follow the output (0) */
    unsigned int   height;
+   int            randr_event;    /* randr event base, -1 if unavailable */
+   bool           randr_outputs;  /* whether it has outputs (1.2 and up) */
+
+   bar_t         *bars;
+   bar_t         *bar;            /* the one being drawn */
+
+   unsigned long  frame_requests;   /* X requests sent by the last draw() */
 } xinfo_t;
 extern xinfo_t XINFO;
 
@@ -49,4 +74,17 @@ extern xinfo_t XINFO;
 extern XftColor COLOR0, COLOR1, COLOR2, COLOR3,
                 COLOR4, COLOR5, COLOR6, COLOR7;
 
+/* the outputs to put a bar on (-O), a comma separated list, or NULL for all */
+extern char *bar_outputs;
+
+/* the layout of the bars (-l), or NULL for the resource or the default */
+extern const char *bar_layout;
+
+/* the windows, and drawing into them (display.c) */
+void setup_x(int x, int y, int w, int h, const char *font);
+void close_x();
+bool process_events();
+void draw();
+void draw_invalidate();
+
 #endif